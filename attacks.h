@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "board.h"
+#include "util.h"
+
+namespace attack_detail {
+
+template <size_t N>
+constexpr std::array<uint64_t, 64> precompute(
+    const std::array<std::pair<int, int>, N>& offsets) {
+    std::array<uint64_t, 64> table{};
+    for (int rank = 0; rank < 8; rank++) {
+        for (int file = 0; file < 8; file++) {
+            for (const auto& [dr, df] : offsets) {
+                if (util::within_bounds(rank + dr, file + df)) {
+                    table[rank * 8 + file] |= 1ULL << ((rank + dr) * 8 + file + df);
+                }
+            }
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::pair<int, int>, 8> knight_offsets{{
+    {2, 1}, {2, -1}, {-2, 1}, {-2, -1},
+    {1, 2}, {1, -2}, {-1, 2}, {-1, -2}
+}};
+
+constexpr std::array<std::pair<int, int>, 8> king_offsets{{
+    {1, -1}, {1, 0}, {1, 1}, {0, -1},
+    {0, 1}, {-1, -1}, {-1, 0}, {-1, 1}
+}};
+
+constexpr std::array<std::pair<int, int>, 2> white_pawn_offsets{{{1, -1}, {1, 1}}};
+constexpr std::array<std::pair<int, int>, 2> black_pawn_offsets{{{-1, -1}, {-1, 1}}};
+
+inline constexpr std::array<uint64_t, 64> knight_attacks = precompute(knight_offsets);
+inline constexpr std::array<uint64_t, 64> king_attacks = precompute(king_offsets);
+inline constexpr std::array<std::array<uint64_t, 64>, 2> pawn_attacks = {
+    precompute(white_pawn_offsets), precompute(black_pawn_offsets)};
+
+} // namespace attack_detail
+
+// Precomputed attack sets of the non-sliding pieces, one bitboard per square.
+// Sliding pieces live in SlidingAttackTable (magic.h).
+class AttackTable {
+public:
+    static uint64_t knight(uint8_t square) { return attack_detail::knight_attacks[square]; }
+    static uint64_t king(uint8_t square) { return attack_detail::king_attacks[square]; }
+
+    // Squares a pawn of the given color on square attacks.
+    static uint64_t pawn(Color color, uint8_t square) {
+        return attack_detail::pawn_attacks[static_cast<int>(color)][square];
+    }
+};
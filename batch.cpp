@@ -0,0 +1,170 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <map>
+#include <mutex>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "eval.h"
+#include "fen.h"
+
+namespace {
+
+bool is_blank(std::string_view line) {
+  return line.empty() || line[0] == '#' || line.find_first_not_of(" \t") == std::string_view::npos;
+}
+
+std::string escape(std::string_view text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    if (static_cast<unsigned char>(c) >= 0x20) {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+std::string analyse(Engine &engine, FENParser &parser, const Engine::SearchLimits &limits,
+                    std::string_view line, uint64_t &nodes) {
+  std::string_view position = FENParser::record_position(line);
+  if (position.empty()) {
+    return std::format(R"({{"fen":"{}","error":"not a FEN or EPD record"}})", escape(line));
+  }
+
+  std::expected<Board, FenError> parsed = parser.parse(position);
+  if (!parsed) {
+    return std::format(R"({{"fen":"{}","error":"{}"}})", escape(position),
+                       escape(to_string(parsed.error().kind)));
+  }
+
+  Board &board = *parsed;
+  if (std::popcount(board.white_kings) != 1 || std::popcount(board.black_kings) != 1) {
+    return std::format(R"({{"fen":"{}","error":"each side needs one king"}})", escape(position));
+  }
+
+  Engine::SearchResult result = engine.search(board, limits);
+  nodes += result.nodes;
+
+  int32_t score = board.turn == Color::White ? result.score : -result.score;
+  std::string best_move = "null";
+  if (result.move == Move{}) {
+    score = engine.in_check(board, board.turn) ? -mate_score : 0;
+  } else {
+    best_move = "\"" + to_string(result.move) + "\"";
+  }
+
+  return std::format(R"({{"fen":"{}","bestmove":{},"score":{},"depth":{},"nodes":{},"time":{:.3f}}})",
+                     escape(position), best_move, score, result.depth, result.nodes,
+                     result.seconds);
+}
+
+} // namespace
+
+Batch::Report Batch::run(const MappedFile &input, std::FILE *out) {
+  auto start = std::chrono::steady_clock::now();
+  size_t workers = std::max<size_t>(options.workers, 1);
+
+  // Many more chunks than workers so that a slow one does not leave the
+  // rest idle at the end, but small enough for ordered output to keep
+  // flowing.
+  std::string_view text = input.view();
+  size_t chunk_bytes = std::clamp<size_t>(text.size() / (workers * 16), 1,
+                                          std::max<size_t>(options.chunk_bytes, 1));
+  std::vector<std::string_view> chunks = partition_lines(text, chunk_bytes);
+  std::atomic<size_t> next_chunk = 0;
+
+  std::mutex output_mutex;
+  std::condition_variable output_advanced;
+  std::map<size_t, std::string> pending; // chunks finished out of order
+  size_t next_output = 0;
+  std::atomic<uint64_t> total_positions = 0;
+  std::atomic<uint64_t> total_nodes = 0;
+
+  // In ordered mode a slow chunk holds back everything after it, so workers
+  // may only run this far ahead of the output; that bounds pending.
+  size_t max_ahead = workers * 4;
+  auto claim_chunk = [&] {
+    if (!options.ordered) {
+      return next_chunk++;
+    }
+    std::unique_lock lock(output_mutex);
+    output_advanced.wait(lock, [&] { return next_chunk - next_output < max_ahead; });
+    return next_chunk++;
+  };
+
+  // Ordered output goes out a chunk at a time, in chunk order.
+  auto emit_chunk = [&](size_t index, std::string results) {
+    std::lock_guard lock(output_mutex);
+    pending.emplace(index, std::move(results));
+    size_t written = next_output;
+    while (!pending.empty() && pending.begin()->first == next_output) {
+      std::fputs(pending.begin()->second.c_str(), out);
+      pending.erase(pending.begin());
+      next_output++;
+    }
+    if (next_output != written) {
+      output_advanced.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; i++) {
+    threads.emplace_back([&] {
+      Engine engine(options.hash_mb, 1);
+      FENParser parser;
+      uint64_t positions = 0;
+      uint64_t nodes = 0;
+
+      for (size_t index = claim_chunk(); index < chunks.size(); index = claim_chunk()) {
+        input.will_need(chunks[index]);
+
+        std::string results;
+        for (std::string_view line : Lines(chunks[index])) {
+          if (is_blank(line)) {
+            continue;
+          }
+          positions++;
+
+          std::string json = analyse(engine, parser, options.limits, line, nodes);
+          if (options.ordered) {
+            results += json;
+            results += '\n';
+          } else {
+            std::lock_guard lock(output_mutex);
+            std::println(out, "{}", json);
+          }
+        }
+
+        if (options.ordered) {
+          emit_chunk(index, std::move(results));
+        }
+      }
+
+      total_positions += positions;
+      total_nodes += nodes;
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::fflush(out);
+
+  Report report;
+  report.positions = total_positions;
+  report.nodes = total_nodes;
+  report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return report;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include "engine.h"
+#include "mapped_file.h"
+
+// Analyses a file of positions, one FEN or EPD record per line, with a pool
+// of independent single-threaded engines. The file is cut into line-aligned
+// chunks that the workers claim in order and read straight from the
+// mapping, so no line is copied onto the heap.
+// Each result is written as one JSON object per line:
+//   {"fen":..., "bestmove":..., "score":..., "depth":..., "nodes":..., "time":...}
+// with the score in centipawns from the side to move's point of view (a
+// mate in n plies is +-(32000 - n)) and the time in seconds. Lines that are
+// not a position get an "error" field.
+class Batch {
+public:
+  struct Options {
+    size_t workers = 1;
+    size_t hash_mb = 16; // per worker
+    Engine::SearchLimits limits;
+    bool ordered = true; // input order, otherwise as completed
+    size_t chunk_bytes = 1 << 16; // upper bound; small files get smaller chunks
+  };
+
+  struct Report {
+    uint64_t positions = 0;
+    uint64_t nodes = 0;
+    double seconds = 0.0;
+
+    double positions_per_second() const { return seconds > 0.0 ? positions / seconds : 0.0; }
+  };
+
+  explicit Batch(const Options &options) : options(options) {}
+
+  Report run(const MappedFile &input, std::FILE *out);
+
+private:
+  Options options;
+};
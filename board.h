@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
 #include <string>
 #include <format>
@@ -9,6 +10,27 @@ enum class Color : uint8_t {
   Black=1
 };
 
+constexpr Color opposite(Color color) {
+  return color == Color::White ? Color::Black : Color::White;
+}
+
+enum class PieceType : uint8_t {
+  None=0,
+  Pawn,
+  Knight,
+  Bishop,
+  Rook,
+  Queen,
+  King
+};
+
+constexpr uint64_t file_a_mask = 0x0101010101010101ULL;
+constexpr uint64_t file_h_mask = 0x8080808080808080ULL;
+constexpr uint64_t rank_1_mask = 0x00000000000000FFULL;
+constexpr uint64_t rank_3_mask = 0x0000000000FF0000ULL;
+constexpr uint64_t rank_6_mask = 0x0000FF0000000000ULL;
+constexpr uint64_t rank_8_mask = 0xFF00000000000000ULL;
+
 struct Square {
   uint8_t rank : 3;
   uint8_t file : 3;
@@ -35,10 +57,6 @@ enum class Result {
 };
 
 struct Board {
-  bool game_over = false;
-  bool is_check = false;
-  Result result = Result::Draw;
-
   uint64_t white_pawns = 0;
   uint64_t white_queens = 0;
   uint64_t white_kings = 0;
@@ -64,14 +82,52 @@ struct Board {
   uint8_t en_passant_file = 0;
   uint8_t en_passant_rank = 0;
 
-  uint8_t half_move = 0;
-  uint8_t full_move = 1;
+  uint16_t half_move = 0;
+  uint16_t full_move = 1;
+
+  // Zobrist key of the position, maintained incrementally by the engine.
+  uint64_t hash = 0;
+
+  // Zobrist key of the pawns alone, for the pawn hash table; also
+  // maintained incrementally.
+  uint64_t pawn_key = 0;
+
+  // Evaluation terms, also maintained incrementally: material and
+  // piece-square values as a packed midgame/endgame Score (see eval.h),
+  // white minus black, and the game phase derived from material.
+  int32_t psq = 0;
+  int32_t phase = 0;
 
   uint64_t white_pieces = 0;
   uint64_t black_pieces = 0;
   uint64_t occupied_squares = 0;
   uint64_t empty_squares = 0;
 
+  uint64_t &pieces(Color color, PieceType type) {
+    assert(type != PieceType::None);
+    return this->*piece_boards[static_cast<int>(color)][static_cast<int>(type)];
+  }
+
+  // PieceType::None reads as an empty bitboard.
+  uint64_t pieces(Color color, PieceType type) const {
+    if (type == PieceType::None) {
+      return 0;
+    }
+    return this->*piece_boards[static_cast<int>(color)][static_cast<int>(type)];
+  }
+
+  // Type of the piece of the given color on the square, or None.
+  PieceType piece_on(Color color, uint8_t square) const {
+    uint64_t pos = 1ULL << square;
+    for (int type = static_cast<int>(PieceType::Pawn);
+         type <= static_cast<int>(PieceType::King); type++) {
+      if (pieces(color, static_cast<PieceType>(type)) & pos) {
+        return static_cast<PieceType>(type);
+      }
+    }
+    return PieceType::None;
+  }
+
   void aggregate() {
     white_pieces = 0;
     black_pieces = 0;
@@ -85,4 +141,14 @@ struct Board {
     occupied_squares = white_pieces | black_pieces;
     empty_squares = ~white_pieces & ~black_pieces;
   }
+
+  // Indexed by [Color][PieceType]; PieceType::None has no bitboard.
+  static constexpr uint64_t Board::*piece_boards[2][7] = {
+      {nullptr, &Board::white_pawns, &Board::white_knights,
+       &Board::white_bishops, &Board::white_rooks, &Board::white_queens,
+       &Board::white_kings},
+      {nullptr, &Board::black_pawns, &Board::black_knights,
+       &Board::black_bishops, &Board::black_rooks, &Board::black_queens,
+       &Board::black_kings},
+  };
 };
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "board.h"
+#include "mapped_file.h"
+#include "move.h"
+
+// A Polyglot opening book (.bin): 16-byte big-endian entries of position
+// key, move, weight and learn data, sorted by key. The file is mapped and
+// searched in place.
+class Book {
+public:
+    // Returns null, after printing why, if the file is missing or
+    // malformed.
+    static std::unique_ptr<Book> open(const std::string& path);
+
+    uint64_t key(const Board& board) const;
+
+    // One of the book moves for the position that is also in legal,
+    // picked at random in proportion to the weights.
+    std::optional<Move> probe(const Board& board, const MoveList& legal);
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint16_t move;
+        uint16_t weight;
+    };
+
+    explicit Book(std::unique_ptr<MappedFile> file)
+        : file(std::move(file)), rng(std::random_device{}()) {}
+
+    size_t size() const { return file->view().size() / 16; }
+    Entry entry(size_t index) const;
+    static std::optional<Move> decode(const Board& board, uint16_t move, const MoveList& legal);
+
+    std::unique_ptr<MappedFile> file;
+    std::mt19937_64 rng;
+};
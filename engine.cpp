@@ -1,196 +1,588 @@
 #include "engine.h"
 
-#include <limits>
+#include <algorithm>
+#include <thread>
 #include <print>
-#include <vector>
 #include <bit>
+#include <cassert>
 
 #include "board.h"
 #include "util.h"
-#include "horse.h"
-
-Engine::Move Engine::best_move(const Board &board, int depth) {
-  Move best_move = {};
-  double best_score = -std::numeric_limits<double>::infinity();
-  double alpha = -std::numeric_limits<double>::infinity();
-  double beta = std::numeric_limits<double>::infinity();
+#include "attacks.h"
+#include "eval.h"
+#include "magic.h"
+#include "threadpool.h"
+#include "zobrist.h"
+
+// Adds (sign 1) or removes (sign -1) a piece's share of the incrementally
+// kept evaluation terms.
+static void update_score(Board &board, Color color, PieceType type,
+                         uint8_t square, int sign) {
+  board.psq += sign * Evaluation::piece_square(color, type, square);
+  board.phase += sign * Evaluation::piece_phase(type);
+}
 
-  std::vector<Move> moves;
-  moves.reserve(64);
-  generate_moves(board, moves);
+// A king move of two files from e1 or e8, which move generation only
+// proposes as castling.
+static bool is_castling(PieceType moved, uint8_t from_square, uint8_t to_square) {
+  return moved == PieceType::King && (from_square == 4 || from_square == 60) &&
+         (to_square == from_square + 2 || from_square == to_square + 2);
+}
 
-  for (const auto& m : moves) {
-    Board b = make_move(board, m);
+// Serializes a target bitboard into moves from a single square.
+static void add_moves(Engine::MoveList &moves, const Square &from,
+                      uint64_t targets) {
+  while (targets) {
+    int to = std::countr_zero(targets);
+    moves.push_back({from, {to / 8, to % 8}, PieceType::None});
+    targets &= targets - 1;
+  }
+}
 
-    double score = alpha_beta(b, depth - 1, b.turn == Color::White, alpha, beta);
+Engine::Engine(size_t hash_mb, size_t threads) : tt(hash_mb) {
+  set_threads(threads);
+}
 
-    if (score > best_score) {
-      best_score = score;
-      best_move = m;
+void Engine::set_threads(size_t count) {
+  search_threads.clear();
+  for (size_t i = 0; i < std::max<size_t>(count, 1); i++) {
+    search_threads.push_back(std::make_unique<SearchThread>());
+    search_threads.back()->id = i;
+    if (network) {
+      search_threads.back()->accumulators.resize(max_ply + 1);
     }
+  }
+}
 
-    alpha = std::max(alpha, best_score);
+bool Engine::load_network(const std::string &path) {
+  if (path.empty()) {
+    network.reset();
+  } else if (!(network = Nnue::load(path))) {
+    return true;
   }
 
-  return best_move;
+  for (auto &thread : search_threads) {
+    thread->accumulators.assign(network ? max_ply + 1 : 0, Nnue::Accumulator{});
+  }
+  return false;
 }
 
+bool Engine::load_book(const std::string &path) {
+  if (path.empty()) {
+    book.reset();
+    return false;
+  }
 
+  std::unique_ptr<Book> opened = Book::open(path);
+  if (!opened) {
+    return true;
+  }
+  book = std::move(opened);
+  return false;
+}
 
-double Engine::alpha_beta(const Board& board, int depth, bool white, double alpha, double beta) {
-  if (depth == 0 || board.game_over) {
-    return evaluate(board);
+TranspositionTable::Stats Engine::tt_stats() const {
+  TranspositionTable::Stats stats;
+  for (const auto &thread : search_threads) {
+    stats += thread->tt_stats;
   }
+  return stats;
+}
 
-  std::vector<Move> moves;
-  moves.reserve(64);
-  generate_moves(board, moves);
+PawnTable::Stats Engine::pawn_stats() const {
+  PawnTable::Stats stats;
+  for (const auto &thread : search_threads) {
+    stats += thread->pawns.stats();
+  }
+  return stats;
+}
 
-  if (moves.empty()) {
-    return evaluate(board);
+uint64_t Engine::total_nodes() const {
+  uint64_t total = 0;
+  for (const auto &thread : search_threads) {
+    total += thread->nodes.load(std::memory_order_relaxed);
   }
+  return total;
+}
 
-  if (white) {
-    double best_score = -std::numeric_limits<double>::infinity();
+Engine::Move Engine::best_move(const Board &board, int depth) {
+  SearchLimits limits;
+  limits.depth = depth;
+  return search(board, limits).move;
+}
 
-    for (const auto &m : moves) {
-      Board b = make_move(board, m);
-      double score = alpha_beta(b, depth-1, false, alpha, beta);
-      best_score = std::max(best_score, score);
-      alpha = std::max(alpha, best_score);
+Engine::Move Engine::best_move(const Board &board, const SearchLimits &limits) {
+  return search(board, limits).move;
+}
 
-      if (beta <= alpha) {
-        break;
-      }
+// Lazy SMP: every thread runs its own iterative deepening on the same root
+// and they cooperate only through the shared transposition table. Helpers
+// start at staggered depths and build their own ordering statistics, so
+// they explore different parts of the tree and leave results the main
+// thread can use. The answer is the main thread's. In Young Brothers Wait
+// mode the main thread searches alone and the others steal split work.
+Engine::SearchResult Engine::search(const Board &board, const SearchLimits &limits) {
+  using namespace std::chrono;
+
+  if (book) {
+    auto book_start = steady_clock::now();
+    MoveList moves;
+    generate_moves(board, moves);
+    if (std::optional<Move> move = book->probe(board, moves)) {
+      SearchResult result;
+      result.move = *move;
+      result.seconds = duration<double>(steady_clock::now() - book_start).count();
+      return result;
     }
+  }
 
-    return best_score;
+  tt.new_search();
+  stop_requested = false;
+  external_stop = limits.stop;
+  node_limit = limits.nodes;
+  start_time = steady_clock::now();
+
+  soft_limit = limits.move_time;
+  if (soft_limit.count() == 0 && limits.time_left.count() > 0) {
+    // Keep a safety margin on the clock for move transmission. Without a
+    // known number of moves left, plan for 30 more.
+    milliseconds usable = std::max(limits.time_left - milliseconds(50), milliseconds(1));
+    int moves_left = limits.moves_to_go > 0 ? limits.moves_to_go : 30;
+    soft_limit = std::min(limits.time_left / moves_left + limits.increment * 3 / 4, usable);
+  }
+  has_deadline = soft_limit.count() > 0;
+  deadline = start_time + soft_limit;
+
+  for (auto &thread : search_threads) {
+    thread->killers.clear();
+    thread->history.age();
+    thread->nodes = 0;
+    thread->result = {};
+  }
+
+  if (parallel_mode == ParallelMode::YoungBrothersWait && search_threads.size() > 1) {
+    // Only the main thread iterates; the others serve split points.
+    WorkStealingPool workers(search_threads.size());
+    pool = &workers;
+    iterative_deepening(*search_threads[0], board, limits);
+    stop_requested = true;
+    pool = nullptr;
   } else {
-    double best_score = std::numeric_limits<double>::infinity();
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < search_threads.size(); i++) {
+      helpers.emplace_back([this, i, &board, &limits] {
+        iterative_deepening(*search_threads[i], board, limits);
+      });
+    }
 
-    for (const auto &m : moves) {
-      Board b = make_move(board, m);
-      double score = alpha_beta(b, depth-1, true, alpha, beta);
-      best_score = std::min(best_score, score);
-      beta = std::min(beta, best_score);
-      if (beta <= alpha) {
+    iterative_deepening(*search_threads[0], board, limits);
+
+    stop_requested = true;
+    for (auto &helper : helpers) {
+      helper.join();
+    }
+  }
+
+  SearchResult result = search_threads[0]->result;
+  result.nodes = 0;
+  for (const auto &thread : search_threads) {
+    uint64_t nodes = thread->nodes.load(std::memory_order_relaxed);
+    result.thread_nodes.push_back(nodes);
+    result.nodes += nodes;
+  }
+  result.seconds = duration<double>(steady_clock::now() - start_time).count();
+  return result;
+}
+
+std::vector<Engine::Move> Engine::principal_variation(const Board &board, const Move &first, int max_length) {
+  std::vector<Move> pv;
+  Board b = board;
+  Move move = first;
+
+  while (static_cast<int>(pv.size()) < max_length) {
+    MoveList moves;
+    generate_moves(b, moves);
+    if (std::find(moves.begin(), moves.end(), move) == moves.end()) {
+      break;
+    }
+
+    pv.push_back(move);
+    b = make_move(b, move);
+
+    TranspositionTable::Entry entry;
+    if (!tt.probe(b.hash, entry) || entry.move == 0) {
+      break;
+    }
+    move = unpack_move(entry.move);
+  }
+
+  return pv;
+}
+
+// Iterative deepening: search depth 1, 2, ... until a limit is hit, keeping
+// the result of the last iteration that finished. An iteration that is cut
+// short is thrown away.
+void Engine::iterative_deepening(SearchThread &thread, const Board &board,
+                                 const SearchLimits &limits) {
+  SearchResult &result = thread.result;
+  Board b = board;
+  bool white = b.turn == Color::White;
+
+  MoveList moves;
+  generate_moves(b, moves);
+  if (moves.empty()) {
+    return;
+  }
+  result.move = moves[0];
+
+  for (int depth = 1 + thread.id % 2; depth <= limits.depth; depth++) {
+    int32_t best_score = white ? -infinite_score : infinite_score;
+    int32_t alpha = -infinite_score;
+    int32_t beta = infinite_score;
+    size_t best_index = 0;
+
+    for (size_t i = 0; i < moves.size(); i++) {
+      Undo undo;
+      do_move(thread, b, moves[i], undo, 0);
+      int32_t score = pool ? ybw(thread, b, depth - 1, 1, !white, alpha, beta, nullptr)
+                           : alpha_beta(thread, b, depth - 1, 1, !white, alpha, beta);
+      undo_move(b, moves[i], undo);
+
+      if (stop_requested) {
         break;
       }
+
+      if (white ? score > best_score : score < best_score) {
+        best_score = score;
+        best_index = i;
+      }
+
+      if (white) {
+        alpha = std::max(alpha, best_score);
+      } else {
+        beta = std::min(beta, best_score);
+      }
+    }
+
+    if (stop_requested) {
+      break;
+    }
+
+    // Search the best move first in the next iteration.
+    std::swap(moves[0], moves[best_index]);
+
+    result.move = moves[0];
+    result.score = best_score;
+    result.depth = depth;
+
+    if (thread.id == 0 && info_callback) {
+      result.nodes = total_nodes();
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+      info_callback(result);
     }
 
-    return best_score;
+    // Another iteration costs several times the last one, so do not start
+    // one that is unlikely to finish.
+    if (thread.id == 0 && has_deadline &&
+        std::chrono::steady_clock::now() - start_time > soft_limit / 2) {
+      break;
+    }
   }
 }
 
-double Engine::evaluate(const Board &board) {
-  if (board.game_over) {
-    switch (board.result) {
-      case Result::WhiteWins:
-        return 1E10;
-      case Result::BlackWins:
-        return -1E10;
-      case Result::Stalemate:
-      case Result::Draw:
-        return 0;
+// Only the main thread polls the limits; helpers follow the stop flag.
+void Engine::check_limits(SearchThread &thread) {
+  if (thread.id != 0) {
+    return;
+  }
+
+  uint64_t nodes = thread.nodes.load(std::memory_order_relaxed);
+  if (node_limit) {
+    if (search_threads.size() == 1) {
+      if (nodes >= node_limit) {
+        stop_requested = true;
+      }
+    } else if ((nodes & 1023) == 0 && total_nodes() >= node_limit) {
+      stop_requested = true;
     }
   }
 
-  double score = 0.0;
+  if ((nodes & 1023) == 0) {
+    if (has_deadline && std::chrono::steady_clock::now() >= deadline) {
+      stop_requested = true;
+    }
+    if (external_stop && external_stop->load(std::memory_order_relaxed)) {
+      stop_requested = true;
+    }
+  }
+}
 
-  score += evaluate_material_count(board);
-  score += evaluate_piece_tables(board);
+int32_t Engine::alpha_beta(SearchThread& thread, Board& board, int depth, int ply, bool white, int32_t alpha, int32_t beta) {
+  // Only this thread writes its counter; a plain load and store avoids a
+  // locked add on every node.
+  thread.nodes.store(thread.nodes.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  check_limits(thread);
+  if (stop_requested) {
+    return 0;
+  }
 
-  return score;
-}
+  if (depth == 0) {
+    return quiescence(thread, board, ply, white, alpha, beta);
+  }
+  if (ply >= max_ply) {
+    return evaluate(thread, board, ply);
+  }
+
+  // Scores are from white's point of view, so the bound kinds mean the same
+  // thing at max (white) and min (black) nodes.
+  int32_t alpha_orig = alpha;
+  int32_t beta_orig = beta;
+  uint16_t hash_move = 0;
+
+  TranspositionTable::Entry entry;
+  thread.tt_stats.probes++;
+  if (tt.probe(board.hash, entry)) {
+    thread.tt_stats.hits++;
+    hash_move = entry.move;
+
+    if (entry.depth >= depth) {
+      int32_t score = score_from_tt(entry.score, ply);
+      switch (entry.bound()) {
+      case TranspositionTable::Bound::Exact:
+        return score;
+      case TranspositionTable::Bound::Lower:
+        alpha = std::max(alpha, score);
+        break;
+      case TranspositionTable::Bound::Upper:
+        beta = std::min(beta, score);
+        break;
+      default:
+        break;
+      }
+
+      if (beta <= alpha) {
+        return score;
+      }
+    }
+  }
 
+  MoveList moves;
+  generate_moves(board, moves);
 
-double Engine::evaluate_material_count(const Board& board) {
-  double score = 0.0;
+  // No legal moves: checkmate or stalemate.
+  if (moves.empty()) {
+    if (in_check(board, board.turn)) {
+      return white ? -(mate_score - ply) : mate_score - ply;
+    }
+    return 0;
+  }
 
-  score += std::popcount(board.white_pawns)   * 1.0;
-  score += std::popcount(board.white_knights) * 3.0;
-  score += std::popcount(board.white_bishops) * 3.0;
-  score += std::popcount(board.white_rooks)   * 5.0;
-  score += std::popcount(board.white_queens)  * 9.0;
-  score += std::popcount(board.white_kings)   * 1E4;
+  int32_t best_score = white ? -infinite_score : infinite_score;
+  Move best = moves[0];
 
-  score -= std::popcount(board.black_pawns)   * 1.0;
-  score -= std::popcount(board.black_knights) * 3.0;
-  score -= std::popcount(board.black_bishops) * 3.0;
-  score -= std::popcount(board.black_rooks)   * 5.0;
-  score -= std::popcount(board.black_queens)  * 9.0;
-  score -= std::popcount(board.black_kings)   * 1E4;
+  // Quiet moves searched before a cutoff get their history lowered.
+  std::array<Move, 64> quiets_tried;
+  size_t quiet_count = 0;
 
-  return score;
-}
+  MovePicker picker(board, moves, unpack_move(hash_move),
+                    thread.killers.killers[ply], thread.history);
+  Move m;
+  while (picker.next(m)) {
+    bool quiet = !MovePicker::is_capture(board, m) && m.promotion == PieceType::None;
 
+    Undo undo;
+    do_move(thread, board, m, undo, ply);
+    int32_t score = alpha_beta(thread, board, depth - 1, ply + 1, !white, alpha, beta);
+    undo_move(board, m, undo);
 
-double Engine::evaluate_piece_tables(const Board& board) {
-  double score = 0.0;
+    if (white ? score > best_score : score < best_score) {
+      best_score = score;
+      best = m;
+    }
 
-  // Piece table scores for pawns
-  {
-    static const int pawn_pst[64] = { 0, 0, 0, 0, 0, 0, 0, 0,
-                                      5, 5, 5, 5, 5, 5, 5, 5,
-                                      1, 1, 2, 3, 3, 2, 1, 1,
-                                      0, 0, 0, 2, 2, 0, 0, 0,
-                                      0, 0, 0, 2, 2, 0, 0, 0,
-                                      1, 1, 1, -1, -1, 1, 1, 1,
-                                      5, 5, 5, -5, -5, 5, 5, 5,
-                                      0, 0, 0, 0, 0, 0, 0, 0};
+    if (white) {
+      alpha = std::max(alpha, best_score);
+    } else {
+      beta = std::min(beta, best_score);
+    }
 
-    for (int rank = 0; rank < 8; rank++) {
-      for (int file = 0; file < 8; file++) {
-        if (board.white_pawns & (1ULL << (rank * 8 + file))) {
-          score += pawn_pst[(7-rank) * 8 + file];
-        }
-        if (board.black_pawns & (1ULL << (rank * 8 + file))) {
-          score += pawn_pst[rank * 8 + file];
+    if (beta <= alpha) {
+      if (quiet && !stop_requested) {
+        thread.killers.update(ply, m);
+        thread.history.update(board.turn, m, depth * depth);
+        for (size_t i = 0; i < quiet_count; i++) {
+          thread.history.update(board.turn, quiets_tried[i], -depth * depth);
         }
       }
+      break;
+    }
+
+    if (quiet && quiet_count < quiets_tried.size()) {
+      quiets_tried[quiet_count++] = m;
     }
   }
 
-  // Piece table scores for pawns
-  {
-    static const int knight_pst[64] = { -1, -1, -1, -1, -1, -1, -1, -1,
-                                      -1, 0, 0, 0, 0, 0, 0, -1,
-                                      -1, 0, 1, 1, 1, 1, 0, -1,
-                                      -1, 0, 1, 3, 3, 1, 0, -1,
-                                      -1, 0, 1, 3, 3, 1, 0, -1,
-                                      -1, 0, 1, 1, 1, 1, 0, -1,
-                                      -1, 0, 0, 0, 0, 0, 0, -1,
-                                      -1, -1, -1, -1, -1, -1, -1, -1};
+  // A search cut short by a limit has an unreliable score; do not keep it.
+  if (stop_requested) {
+    return 0;
+  }
+
+  TranspositionTable::Bound bound = TranspositionTable::Bound::Exact;
+  if (best_score <= alpha_orig) {
+    bound = TranspositionTable::Bound::Upper;
+  } else if (best_score >= beta_orig) {
+    bound = TranspositionTable::Bound::Lower;
+  }
+  tt.store(board.hash, score_to_tt(best_score, ply), pack_move(best), depth, bound);
+  thread.tt_stats.stores++;
 
-    for (int rank = 0; rank < 8; rank++) {
-      for (int file = 0; file < 8; file++) {
-        if (board.white_knights & (1ULL << (rank * 8 + file))) {
-          score += knight_pst[(7-rank) * 8 + file];
-        }
-        if (board.black_knights & (1ULL << (rank * 8 + file))) {
-          score += knight_pst[rank * 8 + file];
-        }
+  return best_score;
+}
+
+// Captures only, with the static evaluation as a lower bound for the side
+// to move ("stand pat"): it can usually decline to capture. That does not
+// hold in check, where every evasion is searched instead. Captures that
+// cannot lift the score to the window even when the piece is won for free
+// are skipped (delta pruning).
+int32_t Engine::quiescence(SearchThread &thread, Board &board, int ply, bool white, int32_t alpha, int32_t beta) {
+  static constexpr int32_t delta_margin = 200;
+
+  thread.nodes.store(thread.nodes.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  check_limits(thread);
+  if (stop_requested) {
+    return 0;
+  }
+
+  int32_t stand_pat = evaluate(thread, board, ply);
+  if (ply >= max_ply) {
+    return stand_pat;
+  }
+
+  bool checked = in_check(board, board.turn);
+  MoveList moves;
+  int32_t best_score;
+  if (checked) {
+    generate_moves(board, moves);
+    if (moves.empty()) {
+      return white ? -(mate_score - ply) : mate_score - ply;
+    }
+    best_score = white ? -infinite_score : infinite_score;
+  } else {
+    if (white) {
+      if (stand_pat >= beta) {
+        return stand_pat;
+      }
+      alpha = std::max(alpha, stand_pat);
+    } else {
+      if (stand_pat <= alpha) {
+        return stand_pat;
       }
+      beta = std::min(beta, stand_pat);
+    }
+    best_score = stand_pat;
+    generate_captures(board, moves);
+  }
+
+  Color them = opposite(board.turn);
+  MovePicker picker(board, moves, {}, thread.killers.killers[ply], thread.history);
+  Move m;
+  while (picker.next(m)) {
+    if (!checked && m.promotion == PieceType::None) {
+      PieceType victim = board.piece_on(them, m.to.rank * 8 + m.to.file);
+      int32_t gain = Evaluation::piece_value(victim == PieceType::None ? PieceType::Pawn : victim);
+      if (white ? stand_pat + gain + delta_margin <= alpha
+                : stand_pat - gain - delta_margin >= beta) {
+        continue;
+      }
+    }
+
+    Undo undo;
+    do_move(thread, board, m, undo, ply);
+    int32_t score = quiescence(thread, board, ply + 1, !white, alpha, beta);
+    undo_move(board, m, undo);
+
+    if (white ? score > best_score : score < best_score) {
+      best_score = score;
+    }
+
+    if (white) {
+      alpha = std::max(alpha, best_score);
+    } else {
+      beta = std::min(beta, best_score);
+    }
+
+    if (beta <= alpha) {
+      break;
     }
   }
 
+  return best_score;
+}
 
+// Material and piece-square sums and the phase are kept up to date by
+// do_move; the pawn terms are added and the two halves blended here.
+int32_t Engine::evaluate(const Board &board) {
+  assert(board.psq == Evaluation::compute_piece_squares(board));
+  assert(board.phase == Evaluation::compute_phase(board));
+  Score pawns = Evaluation::pawn_structure(board) + Evaluation::pawn_shield(board);
+  return Evaluation::taper(board.psq + pawns, board.phase);
+}
 
-  return score;
+int32_t Engine::evaluate(SearchThread &thread, const Board &board, int ply) {
+  if (!network) {
+    assert(board.psq == Evaluation::compute_piece_squares(board));
+    assert(board.phase == Evaluation::compute_phase(board));
+    Score pawns = thread.pawns.probe(board);
+    assert(pawns == Evaluation::pawn_structure(board) + Evaluation::pawn_shield(board));
+    return Evaluation::taper(board.psq + pawns, board.phase);
+  }
+
+  Nnue::Accumulator &accumulator = thread.accumulators[ply];
+  if (!accumulator.computed || accumulator.key != board.hash) {
+    network->refresh(accumulator, board);
+  }
+
+  int32_t score = network->evaluate(accumulator, board.turn);
+  score = std::clamp(score, -mate_threshold + 1, mate_threshold - 1);
+  return board.turn == Color::White ? score : -score;
+}
+
+void Engine::generate_moves(const Board &board, MoveList &moves) {
+  MoveList pseudo;
+  generate_pseudo_moves(board, pseudo);
+  keep_legal(board, pseudo, moves);
 }
 
-void Engine::generate_moves(const Board &board, std::vector<Move> &moves) {
-  std::vector<Move> pseudo;
-  pseudo.reserve(128);
+void Engine::generate_captures(const Board &board, MoveList &moves) {
+  MoveList pseudo;
+  generate_pseudo_captures(board, pseudo);
+  keep_legal(board, pseudo, moves);
+}
+
+void Engine::keep_legal(const Board &board, const MoveList &pseudo, MoveList &moves) {
+  // A move is legal when it does not leave the mover's own king attacked.
+  Board scratch = board;
+  Undo undo;
+  for (const auto& move : pseudo) {
+    do_move(scratch, move, undo);
+    if (!in_check(scratch, board.turn)) {
+      moves.push_back(move);
+    }
+    undo_move(scratch, move, undo);
+  }
+}
+
+void Engine::generate_pseudo_moves(const Board &board, MoveList &pseudo) {
+  generate_pawn_moves(board, pseudo);
 
   for (uint8_t rank = 0; rank < 8; rank++) {
     for (uint8_t file = 0; file < 8; file++) {
       uint64_t pos = (1ULL << (rank * 8 + file));
 
       if (board.turn == Color::White) {
-        if (board.white_pawns & pos) {
-          propose_pawn_moves(board, pseudo, {rank, file});
-        } else if (board.white_knights & pos) {
+        if (board.white_knights & pos) {
           propose_knight_moves(board, pseudo, {rank, file});
         } else if (board.white_bishops & pos) {
           propose_bishop_moves(board, pseudo, {rank, file});
@@ -202,9 +594,7 @@ void Engine::generate_moves(const Board &board, std::vector<Move> &moves) {
           propose_king_moves(board, pseudo, {rank, file});
         }
       } else {
-        if (board.black_pawns & pos) {
-          propose_pawn_moves(board, pseudo, {rank, file});
-        } else if (board.black_knights & pos) {
+        if (board.black_knights & pos) {
           propose_knight_moves(board, pseudo, {rank, file});
         } else if (board.black_bishops & pos) {
           propose_bishop_moves(board, pseudo, {rank, file});
@@ -218,380 +608,512 @@ void Engine::generate_moves(const Board &board, std::vector<Move> &moves) {
       }
     }
   }
-
-  for (auto& move : moves) {
-    Board next_position = make_move(board, move);
-    if (!next_position.is_check) {
-      moves.push_back(move);
-    }
-  }
 }
 
-void Engine::propose_pawn_moves(const Board &board, std::vector<Move> &moves,
-                                const Square &from) {
-  uint64_t from_pos = (1ULL << (from.rank * 8 + from.file));
+// Same targets as generate_pseudo_moves restricted to enemy pieces, plus
+// promotions by push. Under-promotions are left to the main search.
+void Engine::generate_pseudo_captures(const Board &board, MoveList &moves) {
   bool white = board.turn == Color::White;
-
-  int dy = white ? 1 : -1;
-  bool start_square = ((white && (from.rank == 1)) || (!white && (from.rank == 6)));
-
-  // Propose attacking moves
-  {
-    // Attack right
-    {
-      int rank = from.rank + dy;
-      int file = from.file + 1;
-      int pos = (1ULL << (rank * 8 + file));
-      if (util::within_bounds(rank, file) && (board.occupied_squares & pos)) {
-        if ((white && !(board.white_pieces & pos)) ||
-            (!white && !(board.black_pieces & pos))) {
-          moves.push_back({from, {rank, file}});
-        }
-      }
-    }
-
-    // Attack left
-    {
-      int rank = from.rank + dy;
-      int file = from.file - 1;
-      int pos = (1ULL << (rank * 8 + file));
-      if (util::within_bounds(rank, file) && (board.occupied_squares & pos)) {
-        if ((white && !(board.white_pieces & pos)) ||
-            (!white && !(board.black_pieces & pos))) {
-          moves.push_back({from, {rank, file}});
-        }
-      }
-    }
+  Color us = board.turn;
+  uint64_t enemies = white ? board.black_pieces : board.white_pieces;
+  uint64_t occupied = board.occupied_squares;
+
+  uint64_t pawns = board.pieces(us, PieceType::Pawn);
+  uint64_t promotion_rank = white ? rank_8_mask : rank_1_mask;
+  uint64_t pawn_targets = enemies;
+  if (board.has_en_passant) {
+    pawn_targets |= 1ULL << (board.en_passant_rank * 8 + board.en_passant_file);
   }
 
-  {
-    int rank = from.rank + dy;
-    int file = from.file;
+  while (pawns) {
+    int from = std::countr_zero(pawns);
+    Square from_square = {from / 8, from % 8};
+    int push = white ? from + 8 : from - 8;
 
-    if (!util::within_bounds(rank, file)) {
-      return;
+    uint64_t targets = AttackTable::pawn(us, from) & pawn_targets;
+    if ((1ULL << push) & promotion_rank & ~occupied) {
+      targets |= 1ULL << push;
     }
 
-    uint64_t pos = (1ULL << (rank * 8 + file));
-
-    if (!(board.occupied_squares & pos)) {
-      moves.push_back({from, {rank, file}});
-    }
-
-    if (!start_square) {
-      return;
+    while (targets) {
+      int to = std::countr_zero(targets);
+      PieceType promotion = (1ULL << to) & promotion_rank ? PieceType::Queen : PieceType::None;
+      moves.push_back({from_square, {to / 8, to % 8}, promotion});
+      targets &= targets - 1;
     }
+    pawns &= pawns - 1;
+  }
 
-    rank += dy; // if on start pos, move one extra forward for pawn.
-    pos = (1ULL << (rank * 8 + file));
-
-    if (!(board.occupied_squares & pos)) {
-      moves.push_back({from, {rank, file}});
+  for (PieceType type : {PieceType::Knight, PieceType::Bishop, PieceType::Rook,
+                         PieceType::Queen, PieceType::King}) {
+    uint64_t pieces = board.pieces(us, type);
+    while (pieces) {
+      uint8_t from = std::countr_zero(pieces);
+      uint64_t attacks = 0;
+      switch (type) {
+      case PieceType::Knight:
+        attacks = AttackTable::knight(from);
+        break;
+      case PieceType::Bishop:
+        attacks = SlidingAttackTable::bishop(from, occupied);
+        break;
+      case PieceType::Rook:
+        attacks = SlidingAttackTable::rook(from, occupied);
+        break;
+      case PieceType::Queen:
+        attacks = SlidingAttackTable::queen(from, occupied);
+        break;
+      default:
+        attacks = AttackTable::king(from);
+        break;
+      }
+      add_moves(moves, {from / 8, from % 8}, attacks & enemies);
+      pieces &= pieces - 1;
     }
   }
 }
 
-void Engine::propose_knight_moves(const Board &board, std::vector<Move> &moves,
-                                  const Square &from) {
+void Engine::generate_pawn_moves(const Board &board, MoveList &moves) {
   bool white = board.turn == Color::White;
+  uint64_t pawns = white ? board.white_pawns : board.black_pawns;
+  uint64_t enemies = white ? board.black_pieces : board.white_pieces;
 
-  for (auto [r, f] : KnightMoveTable::get(from.rank, from.file)) {
-    uint64_t to_pos = 1ULL << (r * 8 + f);
+  if (board.has_en_passant) {
+    enemies |= 1ULL << (board.en_passant_rank * 8 + board.en_passant_file);
+  }
 
-    if (!util::within_bounds(r, f)) {
-      continue;
-    }
+  // Shift every pawn at once; the targets remember where they came from
+  // through the shift distance.
+  uint64_t push, double_push, attack_left, attack_right;
+  int forward;
+  if (white) {
+    forward = 8;
+    push = (pawns << 8) & board.empty_squares;
+    double_push = ((push & rank_3_mask) << 8) & board.empty_squares;
+    attack_left = ((pawns & ~file_a_mask) << 7) & enemies;
+    attack_right = ((pawns & ~file_h_mask) << 9) & enemies;
+  } else {
+    forward = -8;
+    push = (pawns >> 8) & board.empty_squares;
+    double_push = ((push & rank_6_mask) >> 8) & board.empty_squares;
+    attack_left = ((pawns & ~file_a_mask) >> 9) & enemies;
+    attack_right = ((pawns & ~file_h_mask) >> 7) & enemies;
+  }
 
-    // If same color piece is there, can’t move
-    if (white && (board.white_pieces & to_pos)) {
-      continue;
-    }
-    if (!white && (board.black_pieces & to_pos)) {
-      continue;
+  uint64_t promotion_rank = white ? rank_8_mask : rank_1_mask;
+
+  auto add_pawn_moves = [&](uint64_t targets, int offset) {
+    while (targets) {
+      int to = std::countr_zero(targets);
+      int from = to - offset;
+      Square from_square = {from / 8, from % 8};
+      Square to_square = {to / 8, to % 8};
+
+      if ((1ULL << to) & promotion_rank) {
+        moves.push_back({from_square, to_square, PieceType::Queen});
+        moves.push_back({from_square, to_square, PieceType::Rook});
+        moves.push_back({from_square, to_square, PieceType::Bishop});
+        moves.push_back({from_square, to_square, PieceType::Knight});
+      } else {
+        moves.push_back({from_square, to_square, PieceType::None});
+      }
+
+      targets &= targets - 1;
     }
+  };
 
-    // Otherwise, it’s either empty or an enemy piece, so valid
-    moves.push_back({from, {r, f}});
-  }
+  add_pawn_moves(attack_left, forward - 1);
+  add_pawn_moves(attack_right, forward + 1);
+  add_pawn_moves(push, forward);
+  add_pawn_moves(double_push, 2 * forward);
 }
 
-void Engine::propose_king_moves(const Board &board, std::vector<Move> &moves,
+void Engine::propose_knight_moves(const Board &board, MoveList &moves,
+                                  const Square &from) {
+  uint8_t square = from.rank * 8 + from.file;
+  uint64_t own = board.turn == Color::White ? board.white_pieces : board.black_pieces;
+  add_moves(moves, from, AttackTable::knight(square) & ~own);
+}
+
+void Engine::propose_king_moves(const Board &board, MoveList &moves,
                                 const Square &from) {
-  uint64_t kingPos = 1ULL << (from.rank * 8 + from.file);
+  uint8_t square = from.rank * 8 + from.file;
   bool white = board.turn == Color::White;
+  uint64_t own = white ? board.white_pieces : board.black_pieces;
+  add_moves(moves, from, AttackTable::king(square) & ~own);
+
+  // Castling: the king and rook must be on their home squares, the squares
+  // between them empty, and the king may not start on, pass through or land
+  // on an attacked square. The rights alone are not trusted to imply the
+  // pieces are there.
+  uint8_t home = white ? 4 : 60;
+  uint64_t rooks = board.pieces(board.turn, PieceType::Rook);
+  bool kingside = (white ? board.castle_white_kingside : board.castle_black_kingside) &&
+                  rooks & (1ULL << (home + 3));
+  bool queenside = (white ? board.castle_white_queenside : board.castle_black_queenside) &&
+                   rooks & (1ULL << (home - 4));
+  if (square != home || (!kingside && !queenside)) {
+    return;
+  }
 
-  for (int dy = -1; dy <= 1; dy++) {
-    for (int dx = -1; dx <= 1; dx++) {
-      if (dy == 0 && dx == 0) {
-        continue;
-      }
-
-      int rank = from.rank + dy;
-      int file = from.file + dx;
-
-      if (!util::within_bounds(rank, file)) {
-        continue;
-      }
-
-      Square move = {rank, file};
-      uint64_t move_pos = (1ULL << (rank * 8 + file));
+  Color them = opposite(board.turn);
+  if (is_square_attacked(board, square, them)) {
+    return;
+  }
 
-      if (white) {
-        if (board.white_pieces & move_pos) {
-          continue;
-        }
-      } else {
-        if (board.black_pieces & move_pos) {
-          continue;
-        }
-      }
+  if (kingside && !(board.occupied_squares & (0x60ULL << (home - 4))) &&
+      !is_square_attacked(board, square + 1, them) &&
+      !is_square_attacked(board, square + 2, them)) {
+    moves.push_back({from, {from.rank, 6}, PieceType::None});
+  }
 
-      moves.push_back({from, move});
-    }
+  if (queenside && !(board.occupied_squares & (0x0EULL << (home - 4))) &&
+      !is_square_attacked(board, square - 1, them) &&
+      !is_square_attacked(board, square - 2, them)) {
+    moves.push_back({from, {from.rank, 2}, PieceType::None});
   }
 }
 
-void Engine::propose_rook_moves(const Board &board, std::vector<Move> &moves,
+void Engine::propose_rook_moves(const Board &board, MoveList &moves,
                                 const Square &from) {
+  uint8_t square = from.rank * 8 + from.file;
+  uint64_t own = board.turn == Color::White ? board.white_pieces : board.black_pieces;
+  add_moves(moves, from, SlidingAttackTable::rook(square, board.occupied_squares) & ~own);
+}
 
-  // Lambda to be used by functions that propose moves.
-  // returns true if to break out of for loops.
-  auto propose_rook_move = [&](int rank, int file) {
-    if (!util::within_bounds(rank, file)) {
-      // rook moves outisde of the board, return true
-      return true;
-    }
+void Engine::propose_bishop_moves(const Board &board, MoveList &moves,
+                                  const Square &from) {
+  uint8_t square = from.rank * 8 + from.file;
+  uint64_t own = board.turn == Color::White ? board.white_pieces : board.black_pieces;
+  add_moves(moves, from, SlidingAttackTable::bishop(square, board.occupied_squares) & ~own);
+}
 
-    Square move = {rank, file};
-    uint64_t move_pos = (1ULL << (rank * 8 + file));
-    uint64_t from_pos = (1ULL << (from.rank * 8 + from.file));
-    bool white = board.turn == Color::White;
+void Engine::propose_queen_moves(const Board &board, MoveList &moves,
+                                 const Square &from) {
+  uint8_t square = from.rank * 8 + from.file;
+  uint64_t own = board.turn == Color::White ? board.white_pieces : board.black_pieces;
+  add_moves(moves, from, SlidingAttackTable::queen(square, board.occupied_squares) & ~own);
+}
 
-    if (board.occupied_squares & move_pos) {
-      if ((white && (board.black_pieces & move_pos)) ||
-          (!white && (board.white_pieces & move_pos))) {
-        moves.push_back({from, move});
-      }
+// Copy-make for callers that keep the previous position around. Terminal
+// states are not detected here; see game_result.
+Board Engine::make_move(const Board &board, const Move &move) {
+  Board b = board;
+  Undo undo;
+  do_move(b, move, undo);
+  return b;
+}
 
-      // square was not empty, return true
-      return true;
-    }
+// Accumulators are kept per ply and tagged with the position they were
+// built for. One left stale by a split point or an earlier line is rebuilt
+// from the board before it is used as a parent.
+void Engine::do_move(SearchThread &thread, Board &board, const Move &move, Undo &undo, int ply) {
+  if (!network) {
+    do_move(board, move, undo);
+    return;
+  }
 
-    moves.push_back({from, move});
+  Nnue::Accumulator &parent = thread.accumulators[ply];
+  if (!parent.computed || parent.key != board.hash) {
+    network->refresh(parent, board);
+  }
 
-    return false;
-  };
+  Nnue::Delta delta = Nnue::delta(board, move);
+  do_move(board, move, undo);
 
-  for (int left = 1; left < 7; left++) {
-    int rank = from.rank;
-    int file = from.file - left;
+  Nnue::Accumulator &child = thread.accumulators[ply + 1];
+  network->update(parent, child, delta);
+  child.key = board.hash;
+}
 
-    if (propose_rook_move(rank, file)) {
-      break;
+void Engine::do_move(Board &board, const Move &move, Undo &undo) {
+  uint8_t from_square = move.from.rank * 8 + move.from.file;
+  uint8_t to_square = move.to.rank * 8 + move.to.file;
+  uint64_t from = 1ULL << from_square;
+  uint64_t to = 1ULL << to_square;
+
+  Color us = board.turn;
+  Color them = opposite(us);
+  uint64_t &our_pieces = us == Color::White ? board.white_pieces : board.black_pieces;
+  uint64_t &their_pieces = us == Color::White ? board.black_pieces : board.white_pieces;
+
+  PieceType moved = board.piece_on(us, from_square);
+  PieceType captured = board.piece_on(them, to_square);
+
+  undo.hash = board.hash;
+  undo.pawn_key = board.pawn_key;
+  undo.captured = captured;
+  undo.castling = board.castle_white_kingside | (board.castle_white_queenside << 1) |
+                  (board.castle_black_kingside << 2) | (board.castle_black_queenside << 3);
+  undo.en_passant = board.has_en_passant
+                        ? board.en_passant_rank * 8 + board.en_passant_file
+                        : 0xFF;
+  undo.half_move = board.half_move;
+  undo.psq = board.psq;
+  undo.phase = board.phase;
+
+  if (captured != PieceType::None) {
+    board.pieces(them, captured) &= ~to;
+    their_pieces &= ~to;
+    board.hash ^= Zobrist::piece(them, captured, to_square);
+    if (captured == PieceType::Pawn) {
+      board.pawn_key ^= Zobrist::piece(them, PieceType::Pawn, to_square);
     }
+    update_score(board, them, captured, to_square, -1);
   }
 
-  for (int right = 1; right < 7; right++) {
-    int rank = from.rank;
-    int file = from.file + right;
-
-    if (propose_rook_move(rank, file)) {
-      break;
-    }
+  // Promotion replaces the pawn that arrives with the chosen piece.
+  PieceType placed = move.promotion != PieceType::None ? move.promotion : moved;
+  board.pieces(us, moved) &= ~from;
+  board.pieces(us, placed) |= to;
+  our_pieces ^= from | to;
+  board.hash ^= Zobrist::piece(us, moved, from_square);
+  board.hash ^= Zobrist::piece(us, placed, to_square);
+  if (moved == PieceType::Pawn) {
+    board.pawn_key ^= Zobrist::piece(us, PieceType::Pawn, from_square);
   }
-
-  for (int down = 1; down < 7; down++) {
-    int rank = from.rank - down;
-    int file = from.file;
-
-    if (propose_rook_move(rank, file)) {
-      break;
-    }
+  if (placed == PieceType::Pawn) {
+    board.pawn_key ^= Zobrist::piece(us, PieceType::Pawn, to_square);
+  }
+  update_score(board, us, moved, from_square, -1);
+  update_score(board, us, placed, to_square, 1);
+
+  // Castling is encoded as the king moving two files from e1/e8; bring the
+  // rook along.
+  if (is_castling(moved, from_square, to_square)) {
+    uint8_t rook_from = to_square > from_square ? from_square + 3 : from_square - 4;
+    uint8_t rook_to = to_square > from_square ? from_square + 1 : from_square - 1;
+    uint64_t rook_move = (1ULL << rook_from) | (1ULL << rook_to);
+    assert(board.pieces(us, PieceType::Rook) & (1ULL << rook_from));
+    board.pieces(us, PieceType::Rook) ^= rook_move;
+    our_pieces ^= rook_move;
+    board.hash ^= Zobrist::piece(us, PieceType::Rook, rook_from);
+    board.hash ^= Zobrist::piece(us, PieceType::Rook, rook_to);
+    update_score(board, us, PieceType::Rook, rook_from, -1);
+    update_score(board, us, PieceType::Rook, rook_to, 1);
   }
 
-  for (int up = 1; up < 7; up++) {
-    int rank = from.rank + up;
-    int file = from.file;
+  // En passant: the captured pawn sits beside the moving pawn, behind the
+  // destination square.
+  if (moved == PieceType::Pawn && to_square == undo.en_passant) {
+    uint8_t captured_square = move.from.rank * 8 + move.to.file;
+    board.pieces(them, PieceType::Pawn) &= ~(1ULL << captured_square);
+    their_pieces &= ~(1ULL << captured_square);
+    board.hash ^= Zobrist::piece(them, PieceType::Pawn, captured_square);
+    board.pawn_key ^= Zobrist::piece(them, PieceType::Pawn, captured_square);
+    update_score(board, them, PieceType::Pawn, captured_square, -1);
+    captured = PieceType::Pawn;
+    undo.captured = PieceType::Pawn;
+  }
 
-    if (propose_rook_move(rank, file)) {
-      break;
+  // Castling rights are lost when the king moves or when a rook leaves or is
+  // captured on its corner.
+  uint64_t touched = from | to;
+  if (touched & ((1ULL << 4) | (1ULL << 7) | (1ULL << 0) |
+                 (1ULL << 60) | (1ULL << 63) | (1ULL << 56))) {
+    board.hash ^= Zobrist::castling(board);
+    if (touched & (1ULL << 4)) {
+      board.castle_white_kingside = false;
+      board.castle_white_queenside = false;
+    }
+    if (touched & (1ULL << 7)) {
+      board.castle_white_kingside = false;
+    }
+    if (touched & (1ULL << 0)) {
+      board.castle_white_queenside = false;
+    }
+    if (touched & (1ULL << 60)) {
+      board.castle_black_kingside = false;
+      board.castle_black_queenside = false;
+    }
+    if (touched & (1ULL << 63)) {
+      board.castle_black_kingside = false;
     }
+    if (touched & (1ULL << 56)) {
+      board.castle_black_queenside = false;
+    }
+    board.hash ^= Zobrist::castling(board);
   }
-}
 
-void Engine::propose_bishop_moves(const Board &board, std::vector<Move> &moves,
-                                  const Square &from) {
-  // Lambda to be used by functions that propose moves.
-  // returns true if to break out of for loops.
-  auto propose_bishop_move = [&](int rank, int file) {
-    if (!util::within_bounds(rank, file)) {
-      // bishop moves outisde of the board, return true
-      return true;
-    }
-
-    Square move = {rank, file};
-    uint64_t move_pos = (1ULL << (rank * 8 + file));
-    uint64_t from_pos = (1ULL << (from.rank * 8 + from.file));
-    bool white = board.turn == Color::White;
-
-    if (board.occupied_squares & move_pos) {
-      if ((white && (board.black_pieces & move_pos)) ||
-          (!white && (board.white_pieces & move_pos))) {
-        moves.push_back({from, move});
-      }
+  // A double push leaves an en passant target on the square it skipped.
+  if (board.has_en_passant) {
+    board.hash ^= Zobrist::en_passant(board.en_passant_file);
+  }
+  board.has_en_passant = false;
+  if (moved == PieceType::Pawn && (move.to.rank == move.from.rank + 2 ||
+                                   move.from.rank == move.to.rank + 2)) {
+    board.has_en_passant = true;
+    board.en_passant_file = move.from.file;
+    board.en_passant_rank = (move.from.rank + move.to.rank) / 2;
+    board.hash ^= Zobrist::en_passant(board.en_passant_file);
+  }
 
-      // square was not empty, return true
-      return true;
-    }
+  board.half_move = (moved == PieceType::Pawn || captured != PieceType::None)
+                        ? 0
+                        : board.half_move + 1;
+  if (us == Color::Black) {
+    board.full_move++;
+  }
 
-    moves.push_back({from, move});
+  board.turn = them;
+  board.hash ^= Zobrist::side();
 
-    return false;
-  };
+  board.occupied_squares = board.white_pieces | board.black_pieces;
+  board.empty_squares = ~board.occupied_squares;
 
-  for (int up_left = 1; up_left < 7; up_left++) {
-    int rank = from.rank + up_left;
-    int file = from.file - up_left;
+  assert(board.hash == Zobrist::compute(board));
+  assert(board.pawn_key == Zobrist::compute_pawns(board));
+}
 
-    if (propose_bishop_move(rank, file)) {
-      break;
-    }
+void Engine::undo_move(Board &board, const Move &move, const Undo &undo) {
+  uint8_t from_square = move.from.rank * 8 + move.from.file;
+  uint8_t to_square = move.to.rank * 8 + move.to.file;
+  uint64_t from = 1ULL << from_square;
+  uint64_t to = 1ULL << to_square;
+
+  Color them = board.turn;
+  Color us = opposite(them);
+  uint64_t &our_pieces = us == Color::White ? board.white_pieces : board.black_pieces;
+  uint64_t &their_pieces = us == Color::White ? board.black_pieces : board.white_pieces;
+
+  PieceType placed = board.piece_on(us, to_square);
+  PieceType moved = move.promotion != PieceType::None ? PieceType::Pawn : placed;
+  board.pieces(us, placed) &= ~to;
+  board.pieces(us, moved) |= from;
+  our_pieces ^= from | to;
+
+  if (is_castling(moved, from_square, to_square)) {
+    uint8_t rook_from = to_square > from_square ? from_square + 3 : from_square - 4;
+    uint8_t rook_to = to_square > from_square ? from_square + 1 : from_square - 1;
+    uint64_t rook_move = (1ULL << rook_from) | (1ULL << rook_to);
+    assert(board.pieces(us, PieceType::Rook) & (1ULL << rook_to));
+    board.pieces(us, PieceType::Rook) ^= rook_move;
+    our_pieces ^= rook_move;
   }
 
-  for (int up_right = 1; up_right < 7; up_right++) {
-    int rank = from.rank + up_right;
-    int file = from.file + up_right;
-
-    if (propose_bishop_move(rank, file)) {
-      break;
+  if (undo.captured != PieceType::None) {
+    uint64_t captured = to;
+    if (moved == PieceType::Pawn && to_square == undo.en_passant) {
+      captured = 1ULL << (move.from.rank * 8 + move.to.file);
     }
+    board.pieces(them, undo.captured) |= captured;
+    their_pieces |= captured;
   }
 
-  for (int down_left = 1; down_left < 7; down_left++) {
-    int rank = from.rank - down_left;
-    int file = from.file - down_left;
+  board.castle_white_kingside = undo.castling & 1;
+  board.castle_white_queenside = undo.castling & 2;
+  board.castle_black_kingside = undo.castling & 4;
+  board.castle_black_queenside = undo.castling & 8;
 
-    if (propose_bishop_move(rank, file)) {
-      break;
-    }
+  board.has_en_passant = undo.en_passant != 0xFF;
+  if (board.has_en_passant) {
+    board.en_passant_rank = undo.en_passant / 8;
+    board.en_passant_file = undo.en_passant % 8;
   }
 
-  for (int down_right = 1; down_right < 7; down_right++) {
-    int rank = from.rank - down_right;
-    int file = from.file + down_right;
-
-    if (propose_bishop_move(rank, file)) {
-      break;
-    }
+  board.half_move = undo.half_move;
+  if (us == Color::Black) {
+    board.full_move--;
   }
-}
-
-void Engine::propose_queen_moves(const Board &board, std::vector<Move> &moves,
-                                 const Square &from) {
-  propose_bishop_moves(board, moves, from);
-  propose_rook_moves(board, moves, from);
-}
 
-Board Engine::make_move(const Board &board, const Move &move) {
-  Board b = board;
-  uint64_t from = (1ULL << (move.from.rank * 8 + move.from.file));
-  uint64_t to = (1ULL << (move.to.rank * 8 + move.to.file));
-
-  if (board.white_pawns & from) {
-    b.white_pawns = (board.white_pawns & ~from) | to;
-  } else if (board.white_knights & from) {
-    b.white_knights = (board.white_knights & ~from) | to;
-  } else if (board.white_bishops & from) {
-    b.white_bishops = (board.white_bishops & ~from) | to;
-  } else if (board.white_rooks & from) {
-    b.white_rooks = (board.white_rooks & ~from) | to;
-  } else if (board.white_queens & from) {
-    b.white_queens = (board.white_queens & ~from) | to;
-  } else if (board.white_kings & from) {
-    b.white_kings = (board.white_kings & ~from) | to;
-  } else if (board.black_pawns & from) {
-    b.black_pawns = (board.black_pawns & ~from) | to;
-  } else if (board.black_knights & from) {
-    b.black_knights = (board.black_knights & ~from) | to;
-  } else if (board.black_bishops & from) {
-    b.black_bishops = (board.black_bishops & ~from) | to;
-  } else if (board.black_rooks & from) {
-    b.black_rooks = (board.black_rooks & ~from) | to;
-  } else if (board.black_queens & from) {
-    b.black_queens = (board.black_queens & ~from) | to;
-  } else if (board.black_kings & from) {
-    b.black_kings = (board.black_kings & ~from) | to;
-  }
-
-  if (board.turn == Color::White) {
-    b.turn = Color::Black;
-  } else if (board.turn == Color::Black) {
-    b.turn = Color::White;
-  }
-
-  b.aggregate();
-  b.is_check = in_check(b, b.turn);
-
-  if (is_checkmate(b)) {
-    b.game_over = true;
-    b.result = (b.turn == Color::White) ? Result::BlackWins : Result::WhiteWins;
-  } else if (is_stalemate(b)) {
-    b.game_over = true;
-    b.result = Result::Stalemate;
-  }
+  board.turn = us;
+  board.hash = undo.hash;
+  board.pawn_key = undo.pawn_key;
+  board.psq = undo.psq;
+  board.phase = undo.phase;
 
-  return b;
+  board.occupied_squares = board.white_pieces | board.black_pieces;
+  board.empty_squares = ~board.occupied_squares;
 }
 
 
 bool Engine::is_checkmate(const Board &board) {
-  if (!board.is_check) {
-    return false;
-  }
-
-  std::vector<Move> moves;
+  MoveList moves;
   generate_moves(board, moves);
-  return moves.empty();
+  return moves.empty() && in_check(board, board.turn);
 }
 
 bool Engine::is_stalemate(const Board &board) {
-  if (board.is_check) {
-    return false;
-  }
+  MoveList moves;
+  generate_moves(board, moves);
+  return moves.empty() && !in_check(board, board.turn);
+}
 
-  std::vector<Move> moves;
+std::optional<Result> Engine::game_result(const Board &board) {
+  MoveList moves;
   generate_moves(board, moves);
-  return moves.empty();
+
+  if (moves.empty()) {
+    if (!in_check(board, board.turn)) {
+      return Result::Stalemate;
+    }
+    return board.turn == Color::White ? Result::BlackWins : Result::WhiteWins;
+  }
+
+  // Fifty-move rule.
+  if (board.half_move >= 100) {
+    return Result::Draw;
+  }
+
+  return std::nullopt;
 }
 
 bool Engine::in_check(const Board &board, Color side) {
-  uint64_t king_board =
-      side == Color::White ? board.white_kings : board.black_kings;
+  uint64_t king_board = board.pieces(side, PieceType::King);
 
   if (king_board == 0) {
     // There is literally no king
     return true;
   }
 
-  int king_square_index = std::countr_zero(king_board);
-  int rank = king_square_index / 8;
-  int file = king_square_index % 8;
+  return is_square_attacked(board, std::countr_zero(king_board), opposite(side));
+}
 
-  Color old_turn = board.turn;
+bool Engine::is_square_attacked(const Board &board, uint8_t square, Color by) {
+  // Look outward from the square with each piece's attack pattern; a piece
+  // of that kind found there attacks the square.
+  if (AttackTable::pawn(opposite(by), square) & board.pieces(by, PieceType::Pawn)) {
+    return true;
+  }
+  if (AttackTable::knight(square) & board.pieces(by, PieceType::Knight)) {
+    return true;
+  }
+  if (AttackTable::king(square) & board.pieces(by, PieceType::King)) {
+    return true;
+  }
 
-  Board temp = board;
-  temp.turn = (side == Color::White) ? Color::Black : Color::White;
+  uint64_t queens = board.pieces(by, PieceType::Queen);
+  uint64_t rooks = board.pieces(by, PieceType::Rook) | queens;
+  uint64_t bishops = board.pieces(by, PieceType::Bishop) | queens;
+  return (SlidingAttackTable::rook(square, board.occupied_squares) & rooks) ||
+         (SlidingAttackTable::bishop(square, board.occupied_squares) & bishops);
+}
 
-  std::vector<Move> opponent_moves;
-  generate_moves(temp, opponent_moves);
+uint64_t Engine::attackers_to(const Board &board, uint8_t square) {
+  return attackers_to(board, square, board.occupied_squares);
+}
 
-  uint64_t kingMask = 1ULL << king_square_index;
-  for (auto &m : opponent_moves) {
-    uint64_t moveToMask = 1ULL << (m.to.rank * 8 + m.to.file);
-    if (moveToMask == kingMask) {
-      return true;
-    }
-  }
+uint64_t Engine::attackers_to(const Board &board, uint8_t square, uint64_t occupied) {
+  uint64_t queens = board.white_queens | board.black_queens;
+  return (AttackTable::pawn(Color::Black, square) & board.white_pawns) |
+         (AttackTable::pawn(Color::White, square) & board.black_pawns) |
+         (AttackTable::knight(square) & (board.white_knights | board.black_knights)) |
+         (AttackTable::king(square) & (board.white_kings | board.black_kings)) |
+         (SlidingAttackTable::rook(square, occupied) &
+          (board.white_rooks | board.black_rooks | queens)) |
+         (SlidingAttackTable::bishop(square, occupied) &
+          (board.white_bishops | board.black_bishops | queens));
+}
 
-  return false;
+uint16_t Engine::pack_move(const Move &move) {
+  return static_cast<uint16_t>((move.from.rank * 8 + move.from.file) |
+                               ((move.to.rank * 8 + move.to.file) << 6) |
+                               (static_cast<int>(move.promotion) << 12));
+}
+
+Engine::Move Engine::unpack_move(uint16_t packed) {
+  int from = packed & 0x3F;
+  int to = (packed >> 6) & 0x3F;
+  return {{from / 8, from % 8}, {to / 8, to % 8},
+          static_cast<PieceType>(packed >> 12)};
 }
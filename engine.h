@@ -1,33 +1,214 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "board.h"
+#include "book.h"
+#include "move.h"
+#include "movepick.h"
+#include "nnue.h"
+#include "pawns.h"
+#include "transposition.h"
+
+class WorkStealingPool;
 
 class Engine {
 public:
-    struct Move {
-        Square from;
-        Square to;
+    using Move = ::Move;
+    using MoveList = ::MoveList;
+
+    // Any limit left at zero is not applied. With a clock, the engine budgets
+    // a share of time_left plus most of the increment for this move.
+    struct SearchLimits {
+        int depth = 64;
+        uint64_t nodes = 0;
+        std::chrono::milliseconds move_time{0};
+        std::chrono::milliseconds time_left{0};
+        std::chrono::milliseconds increment{0};
+        int moves_to_go = 0; // moves until the next time control, 0 if unknown
+
+        // Raised by another thread to end the search. Unlike stop(), it
+        // cannot be missed by a search that has not started yet.
+        const std::atomic<bool>* stop = nullptr;
+    };
+
+    // Result of the last fully completed iteration.
+    struct SearchResult {
+        Move move = {};
+        int32_t score = 0; // centipawns, white's point of view
+        int depth = 0;
+        uint64_t nodes = 0;
+        double seconds = 0.0;
+        std::vector<uint64_t> thread_nodes;
+    };
+
+    // Per-thread search state. Threads share only the transposition table
+    // and the stop flag.
+    struct SearchThread {
+        size_t id = 0;
+        KillerTable killers;
+        HistoryTable history;
+        std::atomic<uint64_t> nodes = 0;
+        TranspositionTable::Stats tt_stats;
+        PawnTable pawns;
+        SearchResult result;
+        std::vector<Nnue::Accumulator> accumulators; // by ply, with a network only
+    };
+
+    // How more than one thread shares a search: Lazy SMP runs independent
+    // searches that meet in the transposition table, Young Brothers Wait
+    // splits the remaining moves of a node across a work-stealing pool once
+    // its first move has been searched.
+    enum class ParallelMode {
+        LazySmp,
+        YoungBrothersWait,
     };
 
+    explicit Engine(size_t hash_mb = 16, size_t threads = 1);
+
+    void set_parallel_mode(ParallelMode mode) { parallel_mode = mode; }
+    ParallelMode get_parallel_mode() const { return parallel_mode; }
+
+    // Not to be called while a search is running.
+    void set_threads(size_t count);
+    size_t thread_count() const { return search_threads.size(); }
+    void set_hash(size_t hash_mb) { tt.resize(hash_mb); }
+
+    // Plays from the opening book, when one is loaded and knows the
+    // position, without searching: the result then has depth 0.
+    SearchResult search(const Board& board, const SearchLimits& limits);
+
+    Move best_move(const Board& board, const SearchLimits& limits);
     Move best_move(const Board& board, int depth);
 
-    double alpha_beta(const Board& board, int depth, bool white, double alpha, double beta);
+    // Asks a running search to return; safe to call from another thread.
+    void stop() { stop_requested = true; }
+
+    // Called on the main search thread after every completed iteration,
+    // with nodes and seconds counted so far.
+    using InfoCallback = std::function<void(const SearchResult&)>;
+    void set_info_callback(InfoCallback callback) { info_callback = std::move(callback); }
+
+    // Follows hash moves from the position for as long as they are legal.
+    std::vector<Move> principal_variation(const Board& board, const Move& first, int max_length);
+
+    int32_t alpha_beta(SearchThread& thread, Board& board, int depth, int ply, bool white, int32_t alpha, int32_t beta);
+
+    // Resolves captures below the horizon so leaves are scored in quiet
+    // positions.
+    int32_t quiescence(SearchThread& thread, Board& board, int ply, bool white, int32_t alpha, int32_t beta);
 
-    double evaluate(const Board& board);
-    double evaluate_material_count(const Board& board);
-    double evaluate_piece_tables(const Board& board);
+    // A node whose younger siblings are being searched in parallel.
+    struct SplitPoint;
 
-    void generate_moves(const Board& board, std::vector<Move>& moves);
-    void propose_pawn_moves(const Board& board, std::vector<Move>& moves, const Square& from);
-    void propose_knight_moves(const Board& board, std::vector<Move>& moves, const Square& from);
-    void propose_king_moves(const Board& board, std::vector<Move>& moves, const Square& from);
-    void propose_rook_moves(const Board& board, std::vector<Move>& moves, const Square& from);
-    void propose_bishop_moves(const Board& board, std::vector<Move>& moves, const Square& from);
-    void propose_queen_moves(const Board& board, std::vector<Move>& moves, const Square& from);
+    // Parallel counterpart of alpha_beta used in ParallelMode::YoungBrothersWait;
+    // split is the nearest enclosing split point, or null.
+    int32_t ybw(SearchThread& thread, Board& board, int depth, int ply, bool white,
+                int32_t alpha, int32_t beta, SplitPoint* split);
+
+    // Centipawns from white's point of view.
+    int32_t evaluate(const Board& board);
+
+    // Network evaluation when one is loaded, otherwise evaluate(board) with
+    // the pawn terms taken from the thread's pawn table.
+    int32_t evaluate(SearchThread& thread, const Board& board, int ply);
+
+    // Switches evaluation to the network in the file, or back to the
+    // hand-written terms for an empty path. Returns true on failure.
+    bool load_network(const std::string& path);
+    bool uses_network() const { return network != nullptr; }
+
+    // Opens a Polyglot book, or closes it for an empty path. Returns true
+    // on failure.
+    bool load_book(const std::string& path);
+    bool uses_book() const { return book != nullptr; }
+
+    void generate_moves(const Board& board, MoveList& moves);
+    void generate_pseudo_moves(const Board& board, MoveList& moves);
+    // Legal captures and promotions only, for quiescence search.
+    void generate_captures(const Board& board, MoveList& moves);
+    void generate_pseudo_captures(const Board& board, MoveList& moves);
+    void generate_pawn_moves(const Board& board, MoveList& moves);
+    void propose_knight_moves(const Board& board, MoveList& moves, const Square& from);
+    void propose_king_moves(const Board& board, MoveList& moves, const Square& from);
+    void propose_rook_moves(const Board& board, MoveList& moves, const Square& from);
+    void propose_bishop_moves(const Board& board, MoveList& moves, const Square& from);
+    void propose_queen_moves(const Board& board, MoveList& moves, const Square& from);
+
+    // What do_move overwrites, so undo_move can restore it. The moved and
+    // placed pieces are recovered from the move and the board itself.
+    struct Undo {
+        uint64_t hash;
+        uint64_t pawn_key;
+        PieceType captured;
+        uint8_t castling;    // bit 0..3: white K, white Q, black K, black Q
+        uint8_t en_passant;  // square of the en passant target, 0xFF if none
+        uint16_t half_move;
+        int32_t psq;
+        int32_t phase;
+    };
 
     Board make_move(const Board& board, const Move& move);
 
+    // In-place make/unmake for search; undo_move must be given the same move
+    // and the record filled in by the matching do_move.
+    void do_move(Board& board, const Move& move, Undo& undo);
+
+    // do_move for the search: also brings the network accumulator for
+    // ply + 1 up to date.
+    void do_move(SearchThread& thread, Board& board, const Move& move, Undo& undo, int ply);
+    void undo_move(Board& board, const Move& move, const Undo& undo);
+
     bool is_checkmate(const Board& board);
     bool is_stalemate(const Board& board);
+
+    // Computed on demand: empty if the game goes on.
+    std::optional<Result> game_result(const Board& board);
     bool in_check(const Board& board, Color side);
+    bool is_square_attacked(const Board& board, uint8_t square, Color by);
+
+    // Pieces of both colors attacking square, optionally with a different
+    // occupancy so sliders can be seen through removed pieces.
+    uint64_t attackers_to(const Board& board, uint8_t square);
+    uint64_t attackers_to(const Board& board, uint8_t square, uint64_t occupied);
+
+    static uint16_t pack_move(const Move& move);
+    static Move unpack_move(uint16_t packed);
+
+    TranspositionTable& transposition_table() { return tt; }
+
+    // Probe, hit and store counts summed over all search threads.
+    TranspositionTable::Stats tt_stats() const;
+
+    // Pawn table probe and hit counts summed over all search threads.
+    PawnTable::Stats pawn_stats() const;
+
+private:
+    void iterative_deepening(SearchThread& thread, const Board& board, const SearchLimits& limits);
+    void check_limits(SearchThread& thread);
+    void run_split_task(SearchThread& thread, SplitPoint& split, const Move& move);
+    void keep_legal(const Board& board, const MoveList& pseudo, MoveList& moves);
+    uint64_t total_nodes() const;
+
+    TranspositionTable tt;
+    std::unique_ptr<Nnue> network;
+    std::unique_ptr<Book> book;
+    std::vector<std::unique_ptr<SearchThread>> search_threads;
+    ParallelMode parallel_mode = ParallelMode::LazySmp;
+    WorkStealingPool* pool = nullptr; // set while a YBW search runs
+
+    std::atomic<bool> stop_requested = false;
+    const std::atomic<bool>* external_stop = nullptr;
+    InfoCallback info_callback;
+    uint64_t node_limit = 0;
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::milliseconds soft_limit{0};
+    bool has_deadline = false;
 };
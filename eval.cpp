@@ -0,0 +1,109 @@
+#include "eval.h"
+
+#include <bit>
+
+Score Evaluation::compute_piece_squares(const Board& board) {
+    Score score = 0;
+    for (Color color : {Color::White, Color::Black}) {
+        for (int type = static_cast<int>(PieceType::Pawn);
+             type <= static_cast<int>(PieceType::King); type++) {
+            uint64_t bb = board.pieces(color, static_cast<PieceType>(type));
+            while (bb) {
+                uint8_t square = static_cast<uint8_t>(std::countr_zero(bb));
+                score += piece_square(color, static_cast<PieceType>(type), square);
+                bb &= bb - 1;
+            }
+        }
+    }
+    return score;
+}
+
+int32_t Evaluation::compute_phase(const Board& board) {
+    int32_t phase = 0;
+    for (Color color : {Color::White, Color::Black}) {
+        for (int type = static_cast<int>(PieceType::Knight);
+             type <= static_cast<int>(PieceType::Queen); type++) {
+            PieceType piece = static_cast<PieceType>(type);
+            phase += std::popcount(board.pieces(color, piece)) * piece_phase(piece);
+        }
+    }
+    return phase;
+}
+
+// Each square smeared along its file towards rank 8 or rank 1, itself
+// included.
+static uint64_t fill_north(uint64_t bb) {
+    bb |= bb << 8;
+    bb |= bb << 16;
+    bb |= bb << 32;
+    return bb;
+}
+
+static uint64_t fill_south(uint64_t bb) {
+    bb |= bb >> 8;
+    bb |= bb >> 16;
+    bb |= bb >> 32;
+    return bb;
+}
+
+static uint64_t shift_east(uint64_t bb) { return (bb << 1) & ~file_a_mask; }
+static uint64_t shift_west(uint64_t bb) { return (bb >> 1) & ~file_h_mask; }
+
+Score Evaluation::pawn_terms(uint64_t ours, uint64_t theirs, bool white) {
+    auto back = [white](uint64_t bb) { return white ? bb >> 8 : bb << 8; };
+    auto fill_forward = [white](uint64_t bb) { return white ? fill_north(bb) : fill_south(bb); };
+    auto fill_back = [white](uint64_t bb) { return white ? fill_south(bb) : fill_north(bb); };
+
+    uint64_t files = fill_north(fill_south(ours));
+    uint64_t isolated = ours & ~(shift_east(files) | shift_west(files));
+
+    // Squares behind one of our pawns on its file: the pawns there are the
+    // rear ones of a doubled pair.
+    uint64_t behind_ours = fill_back(back(ours));
+    uint64_t doubled = ours & behind_ours;
+
+    // Squares their pawns still have to pass, which from our side is behind
+    // them, and the squares beside those that they can take on.
+    uint64_t their_path = fill_back(back(theirs));
+    uint64_t guarded = their_path | shift_east(their_path) | shift_west(their_path);
+    uint64_t passed = ours & ~guarded & ~behind_ours;
+
+    // No pawn on a neighbouring file level with or behind it can come up to
+    // defend it, and its stop square is attacked by an enemy pawn.
+    uint64_t supportable = fill_forward(shift_east(ours) | shift_west(ours));
+    uint64_t their_attacks = back(shift_east(theirs) | shift_west(theirs));
+    uint64_t backward = ours & ~supportable & ~isolated & back(their_attacks);
+
+    Score score = doubled_pawn * std::popcount(doubled) + isolated_pawn * std::popcount(isolated) +
+                  backward_pawn * std::popcount(backward);
+    for (; passed; passed &= passed - 1) {
+        int rank = std::countr_zero(passed) / 8;
+        score += passed_pawn[white ? rank : 7 - rank];
+    }
+    return score;
+}
+
+Score Evaluation::pawn_structure(const Board& board) {
+    return pawn_terms(board.white_pawns, board.black_pawns, true) -
+           pawn_terms(board.black_pawns, board.white_pawns, false);
+}
+
+Score Evaluation::king_shield(uint64_t king, uint64_t pawns, bool white) {
+    if (!king) {
+        return 0;
+    }
+    int rank = std::countr_zero(king) / 8;
+    if ((white ? rank : 7 - rank) > 1) {
+        return 0;
+    }
+
+    uint64_t near = white ? king << 8 : king >> 8;
+    near |= shift_east(near) | shift_west(near);
+    uint64_t far = white ? near << 8 : near >> 8;
+    return shield_pawn[0] * std::popcount(pawns & near) + shield_pawn[1] * std::popcount(pawns & far);
+}
+
+Score Evaluation::pawn_shield(const Board& board) {
+    return king_shield(board.white_kings, board.white_pawns, true) -
+           king_shield(board.black_kings, board.black_pawns, false);
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "board.h"
+
+// Scores are in centipawns from white's point of view.
+inline constexpr int32_t mate_score = 32000;
+inline constexpr int32_t infinite_score = 32001;
+
+// Scores at least this far from zero are forced mates; mate_score minus the
+// absolute score is the distance to mate in plies.
+inline constexpr int32_t mate_threshold = mate_score - 1000;
+
+// Search scores mates relative to the root, the transposition table relative
+// to the node that stores them, so an entry stays valid at any ply.
+inline int32_t score_to_tt(int32_t score, int ply) {
+    return score >= mate_threshold ? score + ply : score <= -mate_threshold ? score - ply : score;
+}
+
+inline int32_t score_from_tt(int32_t score, int ply) {
+    return score >= mate_threshold ? score - ply : score <= -mate_threshold ? score + ply : score;
+}
+
+// A midgame and an endgame value packed into one integer, endgame in the
+// upper 16 bits, so a single add or subtract updates both.
+using Score = int32_t;
+
+constexpr Score make_score(int32_t mg, int32_t eg) {
+    return static_cast<Score>(static_cast<uint32_t>(eg) << 16) + mg;
+}
+
+constexpr int32_t mg_value(Score score) {
+    return static_cast<int16_t>(static_cast<uint16_t>(static_cast<uint32_t>(score)));
+}
+
+// Rounds the upper half so a negative midgame value does not borrow from it.
+constexpr int32_t eg_value(Score score) {
+    return static_cast<int16_t>(static_cast<uint16_t>(static_cast<uint32_t>(score + 0x8000) >> 16));
+}
+
+// Material and piece-square tables for a tapered evaluation. The engine
+// keeps Board::psq (the packed sum of both, white minus black) and
+// Board::phase up to date as moves are made, so a static evaluation only
+// has to blend the two halves.
+class Evaluation {
+public:
+    // Phase of the starting material; 0 is a bare pawn endgame.
+    static constexpr int32_t max_phase = 24;
+
+    // Midgame value, for ordering and pruning decisions.
+    static int32_t piece_value(PieceType type) { return mg_value(values[static_cast<int>(type)]); }
+
+    static int32_t piece_phase(PieceType type) { return phases[static_cast<int>(type)]; }
+
+    // Material plus table value of one piece; negative for black.
+    static Score piece_square(Color color, PieceType type, uint8_t square) {
+        return tables.psq[static_cast<int>(color)][static_cast<int>(type)][square];
+    }
+
+    // Interpolates between the midgame and endgame halves by phase.
+    static int32_t taper(Score score, int32_t phase) {
+        if (phase > max_phase) {
+            phase = max_phase; // early promotions
+        }
+        return (mg_value(score) * phase + eg_value(score) * (max_phase - phase)) / max_phase;
+    }
+
+    // Full recomputation; used to initialize a board and to verify.
+    static Score compute_piece_squares(const Board& board);
+    static int32_t compute_phase(const Board& board);
+
+    // Doubled, isolated, backward and passed pawns of both sides, white
+    // minus black. It depends on the pawns alone, so the search caches it
+    // by Board::pawn_key (see pawns.h).
+    static Score pawn_structure(const Board& board);
+
+    // Pawns in front of each king while it stays on its first two ranks.
+    static Score pawn_shield(const Board& board);
+
+private:
+    static constexpr Score doubled_pawn = make_score(-10, -20);
+    static constexpr Score isolated_pawn = make_score(-10, -12);
+    static constexpr Score backward_pawn = make_score(-6, -10);
+
+    // By rank counted from the pawn's own side, on top of the pawn table.
+    static constexpr std::array<Score, 8> passed_pawn = {
+        make_score(0, 0),   make_score(0, 5),   make_score(5, 10),  make_score(10, 20),
+        make_score(20, 35), make_score(35, 60), make_score(55, 90), make_score(0, 0),
+    };
+
+    // For a pawn one and two ranks in front of the king, on its file or
+    // beside it.
+    static constexpr std::array<Score, 2> shield_pawn = {make_score(12, 0), make_score(6, 0)};
+
+    // One side's terms; white says which way its pawns move.
+    static Score pawn_terms(uint64_t ours, uint64_t theirs, bool white);
+    static Score king_shield(uint64_t king, uint64_t pawns, bool white);
+
+    // Indexed by PieceType. Kings are never captured and carry no material.
+    static constexpr std::array<Score, 7> values = {
+        make_score(0, 0),     make_score(82, 94),   make_score(337, 281),
+        make_score(365, 297), make_score(477, 512), make_score(1025, 936),
+        make_score(0, 0),
+    };
+
+    static constexpr std::array<int32_t, 7> phases = {0, 0, 1, 1, 2, 4, 0};
+
+    using Table = std::array<int32_t, 64>;
+
+    // Written from white's side with rank 8 on top, so white reads square ^ 56
+    // and black reads the square as is. Indexed by PieceType.
+    static constexpr std::array<Table, 7> mg_tables = {{
+        {},
+        { // pawn
+            0,  0,  0,  0,  0,  0,  0,  0,
+           50, 50, 50, 50, 50, 50, 50, 50,
+           10, 10, 20, 30, 30, 20, 10, 10,
+            5,  5, 10, 25, 25, 10,  5,  5,
+            0,  0,  0, 20, 20,  0,  0,  0,
+            5, -5,-10,  0,  0,-10, -5,  5,
+            5, 10, 10,-20,-20, 10, 10,  5,
+            0,  0,  0,  0,  0,  0,  0,  0,
+        },
+        { // knight
+          -50,-40,-30,-30,-30,-30,-40,-50,
+          -40,-20,  0,  0,  0,  0,-20,-40,
+          -30,  0, 10, 15, 15, 10,  0,-30,
+          -30,  5, 15, 20, 20, 15,  5,-30,
+          -30,  0, 15, 20, 20, 15,  0,-30,
+          -30,  5, 10, 15, 15, 10,  5,-30,
+          -40,-20,  0,  5,  5,  0,-20,-40,
+          -50,-40,-30,-30,-30,-30,-40,-50,
+        },
+        { // bishop
+          -20,-10,-10,-10,-10,-10,-10,-20,
+          -10,  0,  0,  0,  0,  0,  0,-10,
+          -10,  0,  5, 10, 10,  5,  0,-10,
+          -10,  5,  5, 10, 10,  5,  5,-10,
+          -10,  0, 10, 10, 10, 10,  0,-10,
+          -10, 10, 10, 10, 10, 10, 10,-10,
+          -10,  5,  0,  0,  0,  0,  5,-10,
+          -20,-10,-10,-10,-10,-10,-10,-20,
+        },
+        { // rook
+            0,  0,  0,  0,  0,  0,  0,  0,
+            5, 10, 10, 10, 10, 10, 10,  5,
+           -5,  0,  0,  0,  0,  0,  0, -5,
+           -5,  0,  0,  0,  0,  0,  0, -5,
+           -5,  0,  0,  0,  0,  0,  0, -5,
+           -5,  0,  0,  0,  0,  0,  0, -5,
+           -5,  0,  0,  0,  0,  0,  0, -5,
+            0,  0,  0,  5,  5,  0,  0,  0,
+        },
+        { // queen
+          -20,-10,-10, -5, -5,-10,-10,-20,
+          -10,  0,  0,  0,  0,  0,  0,-10,
+          -10,  0,  5,  5,  5,  5,  0,-10,
+           -5,  0,  5,  5,  5,  5,  0, -5,
+            0,  0,  5,  5,  5,  5,  0, -5,
+          -10,  5,  5,  5,  5,  5,  0,-10,
+          -10,  0,  5,  0,  0,  0,  0,-10,
+          -20,-10,-10, -5, -5,-10,-10,-20,
+        },
+        { // king: stay behind the pawns
+          -30,-40,-40,-50,-50,-40,-40,-30,
+          -30,-40,-40,-50,-50,-40,-40,-30,
+          -30,-40,-40,-50,-50,-40,-40,-30,
+          -30,-40,-40,-50,-50,-40,-40,-30,
+          -20,-30,-30,-40,-40,-30,-30,-20,
+          -10,-20,-20,-20,-20,-20,-20,-10,
+           20, 20,  0,  0,  0,  0, 20, 20,
+           20, 30, 10,  0,  0, 10, 30, 20,
+        },
+    }};
+
+    static constexpr std::array<Table, 7> eg_tables = {{
+        {},
+        { // pawn: advance
+            0,  0,  0,  0,  0,  0,  0,  0,
+           80, 80, 80, 80, 80, 80, 80, 80,
+           50, 50, 50, 50, 50, 50, 50, 50,
+           30, 30, 30, 30, 30, 30, 30, 30,
+           15, 15, 15, 15, 15, 15, 15, 15,
+            5,  5,  5,  5,  5,  5,  5,  5,
+            0,  0,  0,  0,  0,  0,  0,  0,
+            0,  0,  0,  0,  0,  0,  0,  0,
+        },
+        { // knight
+          -50,-40,-30,-30,-30,-30,-40,-50,
+          -40,-20,-10, -5, -5,-10,-20,-40,
+          -30,-10, 10, 15, 15, 10,-10,-30,
+          -30, -5, 15, 20, 20, 15, -5,-30,
+          -30, -5, 15, 20, 20, 15, -5,-30,
+          -30,-10, 10, 15, 15, 10,-10,-30,
+          -40,-20,-10, -5, -5,-10,-20,-40,
+          -50,-40,-30,-30,-30,-30,-40,-50,
+        },
+        { // bishop
+          -20,-10,-10,-10,-10,-10,-10,-20,
+          -10,  0,  0,  0,  0,  0,  0,-10,
+          -10,  0, 10, 10, 10, 10,  0,-10,
+          -10,  0, 10, 15, 15, 10,  0,-10,
+          -10,  0, 10, 15, 15, 10,  0,-10,
+          -10,  0, 10, 10, 10, 10,  0,-10,
+          -10,  0,  0,  0,  0,  0,  0,-10,
+          -20,-10,-10,-10,-10,-10,-10,-20,
+        },
+        { // rook
+           10, 10, 10, 10, 10, 10, 10, 10,
+           15, 15, 15, 15, 15, 15, 15, 15,
+            0,  0,  0,  0,  0,  0,  0,  0,
+            0,  0,  0,  0,  0,  0,  0,  0,
+            0,  0,  0,  0,  0,  0,  0,  0,
+            0,  0,  0,  0,  0,  0,  0,  0,
+            0,  0,  0,  0,  0,  0,  0,  0,
+            0,  0,  0,  0,  0,  0,  0,  0,
+        },
+        { // queen
+          -20,-10,-10, -5, -5,-10,-10,-20,
+          -10,  0,  5,  5,  5,  5,  0,-10,
+          -10,  5, 10, 10, 10, 10,  5,-10,
+           -5,  5, 10, 15, 15, 10,  5, -5,
+           -5,  5, 10, 15, 15, 10,  5, -5,
+          -10,  5, 10, 10, 10, 10,  5,-10,
+          -10,  0,  5,  5,  5,  5,  0,-10,
+          -20,-10,-10, -5, -5,-10,-10,-20,
+        },
+        { // king: come to the centre
+          -50,-40,-30,-20,-20,-30,-40,-50,
+          -30,-20,-10,  0,  0,-10,-20,-30,
+          -30,-10, 20, 30, 30, 20,-10,-30,
+          -30,-10, 30, 40, 40, 30,-10,-30,
+          -30,-10, 30, 40, 40, 30,-10,-30,
+          -30,-10, 20, 30, 30, 20,-10,-30,
+          -30,-30,  0,  0,  0,  0,-30,-30,
+          -50,-30,-30,-30,-30,-30,-30,-50,
+        },
+    }};
+
+    struct Tables {
+        // Indexed by [Color][PieceType][square]; one contiguous 3.5 KB block.
+        std::array<std::array<std::array<Score, 64>, 7>, 2> psq = {};
+    };
+
+    static constexpr Tables generate_tables() {
+        Tables t{};
+        for (int type = static_cast<int>(PieceType::Pawn);
+             type <= static_cast<int>(PieceType::King); type++) {
+            for (int square = 0; square < 64; square++) {
+                Score white = values[type] + make_score(mg_tables[type][square ^ 56],
+                                                        eg_tables[type][square ^ 56]);
+                Score black = values[type] + make_score(mg_tables[type][square],
+                                                        eg_tables[type][square]);
+                t.psq[0][type][square] = white;
+                t.psq[1][type][square] = -black;
+            }
+        }
+        return t;
+    }
+
+    static const Tables tables;
+};
+
+inline constexpr Evaluation::Tables Evaluation::tables = Evaluation::generate_tables();
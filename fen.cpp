@@ -1,370 +1,440 @@
 #include "fen.h"
+#include "eval.h"
+#include "zobrist.h"
 
-#include <iostream>
+#include <algorithm>
+#include <bit>
+#include <charconv>
 #include <cstdint>
-#include <sstream>
 #include <print>
 #include <array>
 
-Board FENParser::parse_fen(const std::string& fen) {
-    Board board;
+const char *to_string(FenError::Kind kind) {
+    switch (kind) {
+    case FenError::Kind::MissingField:
+        return "missing field";
+    case FenError::Kind::BadPlacement:
+        return "bad piece placement";
+    case FenError::Kind::ImpossibleMaterial:
+        return "material no game can reach";
+    case FenError::Kind::BadTurn:
+        return "side to move must be 'w' or 'b'";
+    case FenError::Kind::BadCastling:
+        return "castling must be '-' or some of 'KQkq'";
+    case FenError::Kind::CastlingWithoutPieces:
+        return "castling right without the king and rook on their squares";
+    case FenError::Kind::BadEnPassant:
+        return "bad en passant square";
+    case FenError::Kind::EnPassantWithoutPawn:
+        return "en passant square without the pawn that just moved past it";
+    case FenError::Kind::BadMoveCount:
+        return "bad move counter";
+    case FenError::Kind::TrailingData:
+        return "unexpected data after the position";
+    }
+    return "unknown error";
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Returns the next space-separated field, or an empty view at the end;
+// pos is advanced past it.
+static std::string_view next_field(std::string_view fen, size_t &pos) {
+    while (pos < fen.size() && is_space(fen[pos])) {
+        pos++;
+    }
+    size_t start = pos;
+    while (pos < fen.size() && !is_space(fen[pos])) {
+        pos++;
+    }
+    return fen.substr(start, pos - start);
+}
 
-    std::string board_desc, turn, castle, en_passant, half_move, full_move;
-    if (parse_blocks(fen, board_desc, turn, castle, en_passant, half_move, full_move)) {
-        return board;
+// At most 16 pieces and 8 pawns a side, one king, no pawns on the back
+// ranks, and no more promoted pieces than missing pawns. This also keeps
+// every position within MoveList's capacity.
+static bool material_is_possible(const Board &board) {
+    if ((board.white_pawns | board.black_pawns) & 0xff000000000000ffULL) {
+        return false;
+    }
+    for (Color color : {Color::White, Color::Black}) {
+        int pawns = std::popcount(board.pieces(color, PieceType::Pawn));
+        int knights = std::popcount(board.pieces(color, PieceType::Knight));
+        int bishops = std::popcount(board.pieces(color, PieceType::Bishop));
+        int rooks = std::popcount(board.pieces(color, PieceType::Rook));
+        int queens = std::popcount(board.pieces(color, PieceType::Queen));
+        int kings = std::popcount(board.pieces(color, PieceType::King));
+        int promoted = std::max(queens - 1, 0) + std::max(rooks - 2, 0) +
+                       std::max(bishops - 2, 0) + std::max(knights - 2, 0);
+        if (pawns > 8 || kings > 1 || promoted > 8 - pawns ||
+            pawns + knights + bishops + rooks + queens + kings > 16) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Each castling right needs the king and that rook still on their home
+// squares; move generation and do_move rely on it.
+static bool castling_matches_pieces(const Board &board) {
+    auto home = [](uint64_t pieces, int square) { return (pieces >> square) & 1; };
+    bool white_king = home(board.white_kings, 4);
+    bool black_king = home(board.black_kings, 60);
+    return (!board.castle_white_kingside || (white_king && home(board.white_rooks, 7))) &&
+           (!board.castle_white_queenside || (white_king && home(board.white_rooks, 0))) &&
+           (!board.castle_black_kingside || (black_king && home(board.black_rooks, 63))) &&
+           (!board.castle_black_queenside || (black_king && home(board.black_rooks, 56)));
+}
+
+// The en passant square must be behind a pawn of the side not to move that
+// could just have pushed two squares past it.
+static bool en_passant_matches_pawns(const Board &board) {
+    if (!board.has_en_passant) {
+        return true;
+    }
+    bool white = board.turn == Color::White;
+    if (board.en_passant_rank != (white ? 5 : 2)) {
+        return false;
     }
+    int skipped = board.en_passant_rank * 8 + board.en_passant_file;
+    int pawn = skipped + (white ? -8 : 8);
+    int start = skipped + (white ? 8 : -8);
+    uint64_t pawns = white ? board.black_pawns : board.white_pawns;
+    uint64_t occupied = board.white_pieces | board.black_pieces;
+    return (pawns >> pawn) & 1 && !((occupied >> skipped) & 1) && !((occupied >> start) & 1);
+}
+
+std::expected<Board, FenError> FENParser::parse(std::string_view fen) {
+    Board board;
+    size_t pos = 0;
+
+    auto error = [&](FenError::Kind kind, std::string_view field) {
+        size_t offset = field.empty() ? pos : static_cast<size_t>(field.data() - fen.data());
+        return std::unexpected(FenError{kind, offset});
+    };
 
-    if (parse_board(board, board_desc)) {
-        return board;
+    std::string_view placement = next_field(fen, pos);
+    if (placement.empty()) {
+        return error(FenError::Kind::MissingField, placement);
+    }
+    if (parse_board(board, placement)) {
+        return error(FenError::Kind::BadPlacement, placement);
+    }
+    board.aggregate();
+    if (!material_is_possible(board)) {
+        return error(FenError::Kind::ImpossibleMaterial, placement);
     }
 
+    std::string_view turn = next_field(fen, pos);
+    if (turn.empty()) {
+        return error(FenError::Kind::MissingField, turn);
+    }
     if (parse_turn(board, turn)) {
-        return board;
+        return error(FenError::Kind::BadTurn, turn);
     }
 
+    std::string_view castle = next_field(fen, pos);
+    if (castle.empty()) {
+        return error(FenError::Kind::MissingField, castle);
+    }
     if (parse_castle(board, castle)) {
-        return board;
+        return error(FenError::Kind::BadCastling, castle);
+    }
+    if (!castling_matches_pieces(board)) {
+        return error(FenError::Kind::CastlingWithoutPieces, castle);
     }
 
+    std::string_view en_passant = next_field(fen, pos);
+    if (en_passant.empty()) {
+        return error(FenError::Kind::MissingField, en_passant);
+    }
     if (parse_en_passant(board, en_passant)) {
-        return board;
+        return error(FenError::Kind::BadEnPassant, en_passant);
+    }
+    if (!en_passant_matches_pawns(board)) {
+        return error(FenError::Kind::EnPassantWithoutPawn, en_passant);
+    }
+
+    // The counters are optional, as in EPD, but come as a pair.
+    std::string_view half_move = next_field(fen, pos);
+    if (!half_move.empty()) {
+        std::string_view full_move = next_field(fen, pos);
+        if (full_move.empty()) {
+            return error(FenError::Kind::MissingField, full_move);
+        }
+        if (parse_move_count(board.half_move, half_move)) {
+            return error(FenError::Kind::BadMoveCount, half_move);
+        }
+        if (parse_move_count(board.full_move, full_move)) {
+            return error(FenError::Kind::BadMoveCount, full_move);
+        }
     }
 
-    if (parse_move_count(board, half_move, full_move)) {
-        return board;
+    std::string_view rest = next_field(fen, pos);
+    if (!rest.empty()) {
+        return error(FenError::Kind::TrailingData, rest);
     }
 
+    board.hash = Zobrist::compute(board);
+    board.pawn_key = Zobrist::compute_pawns(board);
+    board.psq = Evaluation::compute_piece_squares(board);
+    board.phase = Evaluation::compute_phase(board);
+
     return board;
 }
 
-bool FENParser::parse_blocks(const std::string& fen,
-                 std::string& board,
-                 std::string& turn,
-                 std::string& castle,
-                 std::string& en_passant,
-                 std::string& half_move,
-                 std::string& full_move) {
-    std::stringstream ss(fen);
-
-    if (!std::getline(ss, board, ' ')) {
-        std::println(stderr, "Expected piece placement block.");
-        return true;
-    }
+static bool is_number(std::string_view text) {
+    return !text.empty() && text.find_first_not_of("0123456789") == std::string_view::npos;
+}
 
-    if (!std::getline(ss, turn, ' ')) {
-        std::println(stderr, "Expected turn block.");
-        return true;
+std::string_view FENParser::record_position(std::string_view line) {
+    std::string_view fields[6];
+    size_t count = 0;
+    size_t pos = 0;
+    while (count < 6) {
+        std::string_view field = next_field(line, pos);
+        if (field.empty()) {
+            break;
+        }
+        fields[count++] = field;
     }
-
-    if (!std::getline(ss, castle, ' ')) {
-        std::println(stderr, "Expected castle block.");
-        return true;
+    if (count < 4) {
+        return {};
     }
 
-    if (!std::getline(ss, en_passant, ' ')) {
-        std::println(stderr, "Expected en_passant block.");
-        return true;
-    }
-
-    if (!std::getline(ss, half_move, ' ')) {
-        std::println(stderr, "Expected half_move block.");
-        return true;
+    std::string_view last = fields[3];
+    if (count == 6 && is_number(fields[4]) && is_number(fields[5])) {
+        last = fields[5];
     }
+    return std::string_view(fields[0].data(), last.data() + last.size() - fields[0].data());
+}
 
-    if (!std::getline(ss, full_move, ' ')) {
-        std::println(stderr, "Expected full_move block.");
-        return true;
+Board FENParser::parse_fen(const std::string& fen) {
+    std::expected<Board, FenError> board = parse(fen);
+    if (!board) {
+        std::println(stderr, "Invalid FEN at offset {}: {}", board.error().offset,
+                     to_string(board.error().kind));
+        return Board{};
     }
-
-    return false;
+    return *board;
 }
 
-bool FENParser::parse_board(Board &board, const std::string &board_desc) {
-  std::stringstream ss(board_desc);
-  std::string rank_line;
-  int rank = 7;
-  while (std::getline(ss, rank_line, '/')) {
+// Ranks from 8 down to 1, each filling exactly eight files.
+bool FENParser::parse_board(Board &board, std::string_view board_desc) {
+    int rank = 7;
     int file = 0;
-    for (int i = 0; i < rank_line.size(); i++) {
-      size_t pos = (1ULL << (rank * 8 + file));
-      switch (rank_line[i]) {
-      case 'r':
-        board.black_rooks |= pos;
-        break;
-      case 'n':
-        board.black_knights |= pos;
-        break;
-      case 'b':
-        board.black_bishops |= pos;
-        break;
-      case 'q':
-        board.black_queens |= pos;
-        break;
-      case 'k':
-        board.black_kings |= pos;
-        break;
-      case 'p':
-        board.black_pawns |= pos;
-        break;
-
-      case 'R':
-        board.white_rooks |= pos;
-        break;
-      case 'N':
-        board.white_knights |= pos;
-        break;
-      case 'B':
-        board.white_bishops |= pos;
-        break;
-      case 'Q':
-        board.white_queens |= pos;
-        break;
-      case 'K':
-        board.white_kings |= pos;
-        break;
-      case 'P':
-        board.white_pawns |= pos;
-        break;
-
-      default:
-        if (rank_line[i] >= '1' && rank_line[i] <= '8') {
-          file += static_cast<size_t>(rank_line[i] - '0');
-          continue;
+    for (char c : board_desc) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) {
+                return true;
+            }
+            rank--;
+            file = 0;
+            continue;
         }
 
-        std::println(
-            stderr,
-            "Unrecognized piece or number in board rank={} i={} char={}", rank,
-            i, rank_line[i]);
-        return true;
+        if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8) {
+                return true;
+            }
+            continue;
+        }
 
-        break;
-      }
+        if (file >= 8) {
+            return true;
+        }
 
-      file++;
+        uint64_t pos = 1ULL << (rank * 8 + file);
+        switch (c) {
+        case 'r': board.black_rooks |= pos; break;
+        case 'n': board.black_knights |= pos; break;
+        case 'b': board.black_bishops |= pos; break;
+        case 'q': board.black_queens |= pos; break;
+        case 'k': board.black_kings |= pos; break;
+        case 'p': board.black_pawns |= pos; break;
+        case 'R': board.white_rooks |= pos; break;
+        case 'N': board.white_knights |= pos; break;
+        case 'B': board.white_bishops |= pos; break;
+        case 'Q': board.white_queens |= pos; break;
+        case 'K': board.white_kings |= pos; break;
+        case 'P': board.white_pawns |= pos; break;
+        default:
+            return true;
+        }
+        file++;
     }
-    rank--;
-  }
 
-  return false;
+    return rank != 0 || file != 8;
 }
 
-bool FENParser::parse_turn(Board& board, const std::string& turn) {
-    if (turn[0] == 'w') {
+bool FENParser::parse_turn(Board& board, std::string_view turn) {
+    if (turn == "w") {
         board.turn = Color::White;
-    } else if (turn[0] == 'b') {
+    } else if (turn == "b") {
         board.turn = Color::Black;
     } else {
-        std::println("Expected turn to be either 'w' or 'b'. Was: '{}'", turn);
         return true;
     }
     return false;
 }
 
-bool FENParser::parse_castle(Board& board, const std::string& castle) {
-    if (castle[0] == '-') {
+bool FENParser::parse_castle(Board& board, std::string_view castle) {
+    if (castle == "-") {
         return false;
     }
 
-    for (size_t i = 0; i < castle.size(); i++) {
-        switch (castle[i]) {
-            case 'q':
-                board.castle_black_queenside = 1;
-                break;
-            case 'k':
-                board.castle_black_kingside = 1;
-                break;
-            case 'Q':
-                board.castle_white_queenside = 1;
-                break;
-            case 'K':
-                board.castle_white_kingside = 1;
-                break;
-            default:
-                std::println(stderr, "In castle block expected 'q', 'Q', 'k', 'K', '-' values but got '{}' in '{}'.", castle[i], castle);
-                break;
+    for (char c : castle) {
+        switch (c) {
+        case 'q':
+            board.castle_black_queenside = true;
+            break;
+        case 'k':
+            board.castle_black_kingside = true;
+            break;
+        case 'Q':
+            board.castle_white_queenside = true;
+            break;
+        case 'K':
+            board.castle_white_kingside = true;
+            break;
+        default:
+            return true;
         }
     }
 
     return false;
 }
 
-bool FENParser::parse_en_passant(Board& board, const std::string& en_passant) {
-    if (en_passant[0] == '-') {
+bool FENParser::parse_en_passant(Board& board, std::string_view en_passant) {
+    if (en_passant == "-") {
         board.has_en_passant = false;
         return false;
     }
 
-    if (en_passant[0] < 'a' || en_passant[0] > 'h') {
-        std::println(stderr, "Failed to parse file in en passant block '{}'", en_passant[0]);
-        return true;
-    }
-
-    if (en_passant[1] < '1' || en_passant[1] > '8') {
-        std::println(stderr, "Failed to parse rank in en passant block '{}'", en_passant[1]);
+    // The skipped square is on rank 3 after a white double push, 6 after black's.
+    if (en_passant.size() != 2 || en_passant[0] < 'a' || en_passant[0] > 'h' ||
+        (en_passant[1] != '3' && en_passant[1] != '6')) {
         return true;
     }
 
-    board.en_passant_file = static_cast<uint8_t>(static_cast<int>(en_passant[0]) - 'a');
-    board.en_passant_rank = static_cast<uint8_t>(static_cast<int>(en_passant[1]) - '1');
+    board.en_passant_file = static_cast<uint8_t>(en_passant[0] - 'a');
+    board.en_passant_rank = static_cast<uint8_t>(en_passant[1] - '1');
     board.has_en_passant = true;
 
     return false;
 }
 
-bool FENParser::parse_move_count(Board& board, const std::string& half_move, const std::string& full_move) {
-    try {
-        board.half_move = std::stoi(half_move);
-    } catch (const std::invalid_argument& ia) {
-        std::println(stderr, "Failed to parse half move.\n{}", ia.what());
-        return true;
-    }
+// Board keeps the counters in 16 bits; larger values are rejected.
+bool FENParser::parse_move_count(uint16_t &count, std::string_view text) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), count);
+    return error != std::errc() || end != text.data() + text.size();
+}
 
-    try {
-        board.full_move = std::stoi(full_move);
-    } catch (const std::invalid_argument& ia) {
-        std::println(stderr, "Failed to parse full move.\n{}", ia.what());
-        return true;
+size_t FENParser::to_fen(const Board& board, std::span<char> buffer) {
+    if (buffer.size() < max_fen_length) {
+        return 0;
     }
 
-    return false;
+    char *out = buffer.data();
+    out = write_board(out, board);
+    *out++ = ' ';
+    out = write_turn(out, board);
+    *out++ = ' ';
+    out = write_castle(out, board);
+    *out++ = ' ';
+    out = write_en_passant(out, board);
+    *out++ = ' ';
+    out = write_move_count(out, board);
+
+    return static_cast<size_t>(out - buffer.data());
 }
 
 std::string FENParser::to_fen(const Board& board) {
-    std::stringstream ss;
-
-    write_board(ss, board);
-    ss << ' ';
-    write_turn(ss, board);
-    ss << ' ';
-    write_castle(ss, board);
-    ss << ' ';
-    write_en_passant(ss, board);
-    ss << ' ';
-    write_move_count(ss, board);
-    ss << '\n';
-
-    return ss.str();
+    std::array<char, max_fen_length> buffer;
+    return std::string(buffer.data(), to_fen(board, buffer));
 }
 
-void FENParser::write_board(std::stringstream& ss, const Board& board) {
-    // for (int rank = 7; rank >= 0; rank--) {
-    //     size_t empty_count = 0;
-    //     for (size_t file = 0; file < 8; file++) {
-    //         bool is_empty = board.pieces[rank*8 + file].type() == PieceType::None;
-
-    //         if (is_empty) {
-    //             empty_count++;
-    //             continue;
-    //         }
-
-    //         // not empty
-    //         if (empty_count > 0) {
-    //             ss << empty_count;
-    //             empty_count = 0;
-    //         }
-
-    //         PieceType type = board.pieces[rank*8 + file].type();
-    //         Color color = board.pieces[rank*8 + file].color();
-    //         switch (type) {
-    //         case PieceType::Rook:
-    //           if (color == Color::White) {
-    //             ss << 'R';
-    //           } else {
-    //             ss << 'r';
-    //           }
-    //           break;
-    //         case PieceType::Queen:
-    //           if (color == Color::White) {
-    //             ss << 'Q';
-    //           } else {
-    //             ss << 'q';
-    //           }
-    //           break;
-    //         case PieceType::King:
-    //           if (color == Color::White) {
-    //             ss << 'K';
-    //           } else {
-    //             ss << 'k';
-    //           }
-    //           break;
-    //         case PieceType::Bishop:
-    //           if (color == Color::White) {
-    //             ss << 'B';
-    //           } else {
-    //             ss << 'b';
-    //           }
-    //           break;
-    //         case PieceType::Knight:
-    //           if (color == Color::White) {
-    //             ss << 'N';
-    //           } else {
-    //             ss << 'n';
-    //           }
-    //           break;
-    //         case PieceType::Pawn:
-    //           if (color == Color::White) {
-    //             ss << 'P';
-    //           } else {
-    //             ss << 'p';
-    //           }
-    //           break;
-    //         default:
-    //             break;
-    //         }
-    //     }
-
-    //     if (empty_count > 0) {
-    //       ss << empty_count;
-    //     }
-
-    //     if (rank > 0) {
-    //         ss << '/';
-    //     }
-    // }
-}
+char *FENParser::write_board(char *out, const Board& board) {
+    static constexpr char symbols[2][7] = {
+        {' ', 'P', 'N', 'B', 'R', 'Q', 'K'},
+        {' ', 'p', 'n', 'b', 'r', 'q', 'k'},
+    };
+
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty_count = 0;
+        for (int file = 0; file < 8; file++) {
+            uint8_t square = static_cast<uint8_t>(rank * 8 + file);
+            Color color = Color::White;
+            PieceType type = board.piece_on(Color::White, square);
+            if (type == PieceType::None) {
+                color = Color::Black;
+                type = board.piece_on(Color::Black, square);
+            }
+
+            if (type == PieceType::None) {
+                empty_count++;
+                continue;
+            }
+
+            if (empty_count > 0) {
+                *out++ = static_cast<char>('0' + empty_count);
+                empty_count = 0;
+            }
+            *out++ = symbols[static_cast<int>(color)][static_cast<int>(type)];
+        }
 
-void FENParser::write_turn(std::stringstream& ss, const Board& board) {
-    if (static_cast<Color>(board.turn) == Color::White) {
-        ss << 'w';
-    } else {
-        ss << 'b';
+        if (empty_count > 0) {
+            *out++ = static_cast<char>('0' + empty_count);
+        }
+
+        if (rank > 0) {
+            *out++ = '/';
+        }
     }
+    return out;
 }
 
+char *FENParser::write_turn(char *out, const Board& board) {
+    *out++ = board.turn == Color::White ? 'w' : 'b';
+    return out;
+}
 
-void FENParser::write_castle(std::stringstream& ss, const Board& board) {
+char *FENParser::write_castle(char *out, const Board& board) {
+    char *start = out;
     if (board.castle_white_kingside) {
-        ss << 'K';
+        *out++ = 'K';
     }
     if (board.castle_white_queenside) {
-        ss << 'Q';
+        *out++ = 'Q';
     }
     if (board.castle_black_kingside) {
-        ss << 'k';
+        *out++ = 'k';
     }
     if (board.castle_black_queenside) {
-        ss << 'q';
+        *out++ = 'q';
     }
-    if ((board.castle_black_kingside
-         | board.castle_black_queenside
-         | board.castle_white_kingside
-         | board.castle_white_queenside) == 0) {
-        ss << '-';
+    if (out == start) {
+        *out++ = '-';
     }
+    return out;
 }
 
-
-void FENParser::write_en_passant(std::stringstream& ss, const Board& board) {
+char *FENParser::write_en_passant(char *out, const Board& board) {
     if (!board.has_en_passant) {
-        ss << '-';
-        return;
+        *out++ = '-';
+        return out;
     }
 
-    ss << static_cast<char>(board.en_passant_file + 'a');
-    ss << static_cast<char>(board.en_passant_rank + '1');
+    *out++ = static_cast<char>(board.en_passant_file + 'a');
+    *out++ = static_cast<char>(board.en_passant_rank + '1');
+    return out;
 }
 
-void FENParser::write_move_count(std::stringstream &ss, const Board &board) {
-  ss << static_cast<int>(board.half_move) << ' ' << static_cast<int>(board.full_move);
+char *FENParser::write_move_count(char *out, const Board &board) {
+    out = std::to_chars(out, out + 5, board.half_move).ptr;
+    *out++ = ' ';
+    return std::to_chars(out, out + 5, board.full_move).ptr;
 }
@@ -2,37 +2,71 @@
 
 #include "board.h"
 
-#include <sstream>
+#include <cstddef>
+#include <expected>
+#include <span>
+#include <string>
+#include <string_view>
 
-class FENParser {
-public:
-  Board parse_fen(const std::string &fen);
-  std::string to_fen(const Board& board);
-
-private:
-  bool parse_blocks(const std::string &fen, std::string &board,
-                    std::string &turn, std::string &castle,
-                    std::string &en_passant, std::string &half_move,
-                    std::string &full_move);
-
-  bool parse_board(Board &board, const std::string &board_desc);
+// Why a FEN string was rejected, and the offset into it where parsing
+// stopped.
+struct FenError {
+  enum class Kind : uint8_t {
+    MissingField,
+    BadPlacement,
+    ImpossibleMaterial,
+    BadTurn,
+    BadCastling,
+    CastlingWithoutPieces,
+    BadEnPassant,
+    EnPassantWithoutPawn,
+    BadMoveCount,
+    TrailingData,
+  };
 
-  bool parse_turn(Board &board, const std::string &turn);
+  Kind kind;
+  size_t offset;
+};
 
-  bool parse_castle(Board &board, const std::string &castle);
+const char *to_string(FenError::Kind kind);
 
-  bool parse_en_passant(Board &board, const std::string &en_passant);
+class FENParser {
+public:
+  // Longest FEN to_fen can produce: 71 placement characters plus the other
+  // fields with five-digit move counters.
+  static constexpr size_t max_fen_length = 94;
 
-  bool parse_move_count(Board &board, const std::string &half_move,
-                        const std::string &full_move);
+  // Parses without allocating. The move counters may be left out and
+  // default to "0 1"; trailing whitespace is ignored. The board comes back
+  // aggregated, with its hash and evaluation terms set. Impossible material,
+  // castling rights without the king and rook at home, and en passant
+  // squares no double push could have left are rejected.
+  std::expected<Board, FenError> parse(std::string_view fen);
 
-  void write_board(std::stringstream& ss, const Board& board);
+  // The position part of a FEN or EPD line: the first four fields, plus the
+  // move counters if the next two fields are numbers. An EPD record has
+  // operations such as `bm e4; id "x";` instead. Empty if the line has fewer
+  // than four fields.
+  static std::string_view record_position(std::string_view line);
 
-  void write_turn(std::stringstream& ss, const Board& board);
+  // parse, printing the error and returning an empty board on failure.
+  Board parse_fen(const std::string &fen);
 
-  void write_castle(std::stringstream &ss, const Board &board);
+  // Writes the FEN into buffer without a terminator and returns its length,
+  // or 0 if the buffer is shorter than max_fen_length.
+  size_t to_fen(const Board &board, std::span<char> buffer);
+  std::string to_fen(const Board &board);
 
-  void write_en_passant(std::stringstream &ss, const Board &board);
+private:
+  bool parse_board(Board &board, std::string_view board_desc);
+  bool parse_turn(Board &board, std::string_view turn);
+  bool parse_castle(Board &board, std::string_view castle);
+  bool parse_en_passant(Board &board, std::string_view en_passant);
+  bool parse_move_count(uint16_t &count, std::string_view text);
 
-  void write_move_count(std::stringstream &ss, const Board &board);
+  char *write_board(char *out, const Board &board);
+  char *write_turn(char *out, const Board &board);
+  char *write_castle(char *out, const Board &board);
+  char *write_en_passant(char *out, const Board &board);
+  char *write_move_count(char *out, const Board &board);
 };
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define CHESS_HAS_PEXT 1
+#endif
+
+// Precomputed rook and bishop attack sets. A lookup masks the relevant
+// occupancy of the square and maps it to a table slot, either with a magic
+// multiply or, on CPUs with BMI2, with PEXT (chosen once at startup).
+class SlidingAttackTable {
+public:
+    static uint64_t rook(uint8_t square, uint64_t occupied) {
+        return rook_entries[square].lookup(occupied);
+    }
+
+    static uint64_t bishop(uint8_t square, uint64_t occupied) {
+        return bishop_entries[square].lookup(occupied);
+    }
+
+    static uint64_t queen(uint8_t square, uint64_t occupied) {
+        return rook(square, occupied) | bishop(square, occupied);
+    }
+
+    static bool uses_pext() { return pext; }
+
+    struct Entry {
+        const uint64_t* attacks = nullptr;
+        uint64_t mask = 0;
+        uint64_t magic = 0;
+        uint8_t shift = 0;
+
+        uint64_t lookup(uint64_t occupied) const {
+#ifdef CHESS_HAS_PEXT
+            if (pext) {
+                return attacks[pext_index(occupied, mask)];
+            }
+#endif
+            return attacks[((occupied & mask) * magic) >> shift];
+        }
+    };
+
+private:
+#ifdef CHESS_HAS_PEXT
+    [[gnu::target("bmi2")]] static uint64_t pext_index(uint64_t occupied, uint64_t mask) {
+        return _pext_u64(occupied, mask);
+    }
+#endif
+
+    static std::array<Entry, 64> rook_entries;
+    static std::array<Entry, 64> bishop_entries;
+    static bool pext;
+
+    friend struct SlidingAttackTableInit;
+};
@@ -1,27 +1,420 @@
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "batch.h"
 #include "fen.h"
+#include "mapped_file.h"
+#include "nnue.h"
+#include "packed.h"
 #include "util.h"
 #include "engine.h"
+#include "perft.h"
+#include "uci.h"
 
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        std::println("Usage: {} file_path.fen", argv[0]);
+static void print_usage(const char *program) {
+    std::println("Usage: {} [uci]", program);
+    std::println("       {} file_path.fen [movetime_ms] [threads] [network.nnue|-] [book.bin|-]", program);
+    std::println("       {} perft file_path.fen depth", program);
+    std::println("       {} divide file_path.fen depth", program);
+    std::println("       {} perft-suite [max_depth]", program);
+    std::println("       {} bench-parallel depth threads [file_path.fen]", program);
+    std::println("       {} bench-fen [iterations]", program);
+    std::println("       {} nnue-check network.nnue", program);
+    std::println("       {} pack positions.epd positions.pos", program);
+    std::println("       {} batch positions.epd [--workers n] [--depth d] [--nodes n] [--movetime ms]", program);
+    std::println("             [--hash mb] [--unordered] [--output results.jsonl]");
+}
+
+static int run_perft(int argc, char *argv[]) {
+    std::string_view mode = argv[1];
+
+    if (mode == "perft-suite") {
+        int max_depth = argc > 2 ? std::stoi(argv[2]) : 3;
+        Engine engine;
+        Perft perft(engine);
+        return perft.run_suite(max_depth) ? 1 : 0;
+    }
+
+    if (argc < 4) {
+        print_usage(argv[0]);
         return 1;
     }
 
     FENParser parser;
-    Board board = parser.parse_fen(util::read_file(argv[1]));
+    Board board = parser.parse_fen(util::read_file(argv[2]));
+    board.aggregate();
+    int depth = std::stoi(argv[3]);
+
+    Engine engine;
+    Perft perft(engine);
+    Perft::Report report = mode == "divide" ? perft.divide(board, depth)
+                                            : perft.run(board, depth);
+
+    std::println("Nodes: {}", report.nodes);
+    std::println("Time: {:.3f} s", report.seconds);
+    std::println("NPS: {:.0f}", report.nps());
+    return 0;
+}
+
+// Fixed-depth search with one thread and then with N threads splitting the
+// tree by Young Brothers Wait. Speedup is the ratio of the two times and
+// efficiency is the speedup per thread.
+static int run_bench_parallel(int argc, char *argv[]) {
+    if (argc < 4) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int depth = std::stoi(argv[2]);
+    size_t threads = std::stoul(argv[3]);
+
+    FENParser parser;
+    Board board = parser.parse_fen(argc > 4 ? util::read_file(argv[4])
+                                            : "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
     board.aggregate();
 
+    Engine::SearchLimits limits;
+    limits.depth = depth;
+
+    double serial_seconds = 0.0;
+    for (size_t n : {size_t{1}, threads}) {
+        Engine engine(16, n);
+        engine.set_parallel_mode(Engine::ParallelMode::YoungBrothersWait);
+        Engine::SearchResult search = engine.search(board, limits);
+        if (n == 1) {
+            serial_seconds = search.seconds;
+        }
+
+        double speedup = search.seconds > 0.0 ? serial_seconds / search.seconds : 0.0;
+        std::println("threads {:>2}: {} depth {} nodes {:>10} time {:.3f} s nps {:>10.0f} speedup {:.2f} efficiency {:.2f}",
+                     n, to_string(search.move), search.depth, search.nodes, search.seconds,
+                     search.seconds > 0.0 ? search.nodes / search.seconds : 0.0,
+                     speedup, speedup / n);
+    }
+    return 0;
+}
+
+// Parses and writes back the perft reference positions, timing each half.
+static int run_bench_fen(int argc, char *argv[]) {
+    using clock = std::chrono::steady_clock;
+
+    size_t iterations = argc > 2 ? std::stoul(argv[2]) : 100000;
+    const std::vector<Perft::Position> &positions = Perft::reference_positions();
+
+    FENParser parser;
+    std::vector<Board> boards;
+    for (const Perft::Position &position : positions) {
+        std::expected<Board, FenError> board = parser.parse(position.fen);
+        if (!board) {
+            std::println(stderr, "{}: {}", position.fen, to_string(board.error().kind));
+            return 1;
+        }
+        boards.push_back(*board);
+    }
+
+    // The checksums keep the loops from being optimised away.
+    uint64_t checksum = 0;
+    auto start = clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        for (const Perft::Position &position : positions) {
+            checksum += parser.parse(position.fen)->hash;
+        }
+    }
+    double parse_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::array<char, FENParser::max_fen_length> buffer;
+    start = clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        for (const Board &board : boards) {
+            checksum += parser.to_fen(board, buffer);
+        }
+    }
+    double write_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::vector<PackedBoard> packed(boards.size());
+    PackedFormat::encode(boards, packed);
+    std::vector<Board> decoded(boards.size());
+    start = clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        PackedFormat::decode(packed, decoded);
+        checksum += decoded.back().hash;
+    }
+    double decode_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        PackedFormat::encode(boards, packed);
+        checksum += packed.back().occupied;
+    }
+    double encode_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    double count = static_cast<double>(iterations * positions.size());
+    std::println("parse:  {:.0f} positions/s", count / parse_seconds);
+    std::println("to_fen: {:.0f} positions/s", count / write_seconds);
+    std::println("decode: {:.0f} positions/s", count / decode_seconds);
+    std::println("encode: {:.0f} positions/s", count / encode_seconds);
+    std::println("checksum {:x}", checksum);
+    return 0;
+}
+
+// Evaluates the perft reference positions and every move from them with
+// the AVX2 and the portable NNUE kernels, and reports any difference in
+// the accumulators or the scores, refreshed or updated incrementally.
+static int run_nnue_check(int argc, char *argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<Nnue> network = Nnue::load(argv[2]);
+    if (!network) {
+        return 1;
+    }
+    if (!Nnue::uses_avx2()) {
+        std::println("No AVX2 on this CPU; only the portable kernels run.");
+        return 0;
+    }
+
+    struct Output {
+        Nnue::Accumulator root;
+        Nnue::Accumulator updated;
+        Nnue::Accumulator refreshed;
+        int32_t root_score;
+        int32_t updated_score;
+        int32_t refreshed_score;
+    };
+
     Engine engine;
-    for (int i = 0; i < 50 && !board.game_over; i++) {
-      Engine::Move move = engine.best_move(board, 7);
-      std::println("Best move: {} -> {}", to_string(move.from),
-                   to_string(move.to));
+    FENParser parser;
+    uint64_t checked = 0;
+    uint64_t mismatches = 0;
+    for (const Perft::Position &position : Perft::reference_positions()) {
+        Board board = *parser.parse(position.fen);
+        MoveList moves;
+        engine.generate_moves(board, moves);
+
+        for (const Move &move : moves) {
+            Board child = engine.make_move(board, move);
+            Output outputs[2];
+            for (int avx2 = 0; avx2 < 2; avx2++) {
+                Nnue::set_avx2(avx2);
+                Output &out = outputs[avx2];
+                network->refresh(out.root, board);
+                network->update(out.root, out.updated, Nnue::delta(board, move));
+                network->refresh(out.refreshed, child);
+                out.root_score = network->evaluate(out.root, board.turn);
+                out.updated_score = network->evaluate(out.updated, child.turn);
+                out.refreshed_score = network->evaluate(out.refreshed, child.turn);
+            }
+
+            const Output &avx2 = outputs[1];
+            const Output &scalar = outputs[0];
+            if (avx2.root.values != scalar.root.values || avx2.updated.values != scalar.updated.values ||
+                avx2.refreshed.values != scalar.refreshed.values ||
+                scalar.updated.values != scalar.refreshed.values ||
+                avx2.root_score != scalar.root_score || avx2.updated_score != scalar.updated_score ||
+                avx2.refreshed_score != scalar.refreshed_score) {
+                std::println("mismatch: {} after {}: scalar {} / {}, avx2 {} / {}", position.fen,
+                             to_string(move), scalar.updated_score, scalar.refreshed_score,
+                             avx2.updated_score, avx2.refreshed_score);
+                mismatches++;
+            }
+            checked++;
+        }
+    }
+    Nnue::set_avx2(true);
+
+    std::println("{} moves checked, {} mismatches", checked, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Converts a FEN or EPD file to the packed binary format, skipping lines
+// that are not a position.
+static int run_pack(int argc, char *argv[]) {
+    if (argc < 4) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<MappedFile> input = MappedFile::open(argv[2]);
+    std::unique_ptr<PackedWriter> writer = input ? PackedWriter::create(argv[3]) : nullptr;
+    if (!writer) {
+        return 1;
+    }
+
+    FENParser parser;
+    std::vector<PackedBoard> records;
+    uint64_t skipped = 0;
+    for (std::string_view line : Lines(input->view())) {
+        std::expected<Board, FenError> board = parser.parse(FENParser::record_position(line));
+        PackedBoard record;
+        if (!board || PackedFormat::encode(*board, record)) {
+            skipped++;
+            continue;
+        }
+
+        records.push_back(record);
+        if (records.size() == 4096) {
+            if (writer->write(records)) {
+                return 1;
+            }
+            records.clear();
+        }
+    }
+    if (writer->write(records) || writer->finish()) {
+        return 1;
+    }
+
+    uint64_t bytes = sizeof(PackedHeader) + writer->count() * sizeof(PackedBoard);
+    std::println("{} positions, {} lines skipped, {} -> {} bytes", writer->count(), skipped,
+                 input->view().size(), bytes);
+    return 0;
+}
+
+// One FEN or EPD record per line in, one JSON result per line out.
+static int run_batch(int argc, char *argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    Batch::Options options;
+    options.limits.depth = 8;
+    const char *output_path = nullptr;
+
+    for (int i = 3; i < argc; i++) {
+        std::string_view flag = argv[i];
+        if (flag == "--unordered") {
+            options.ordered = false;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+        if (flag == "--workers") {
+            options.workers = std::stoul(value);
+        } else if (flag == "--depth") {
+            options.limits.depth = std::stoi(value);
+        } else if (flag == "--nodes") {
+            options.limits.nodes = std::stoull(value);
+        } else if (flag == "--movetime") {
+            options.limits.move_time = std::chrono::milliseconds(std::stoi(value));
+        } else if (flag == "--hash") {
+            options.hash_mb = std::stoul(value);
+        } else if (flag == "--output") {
+            output_path = value;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::unique_ptr<MappedFile> input = MappedFile::open(argv[2]);
+    if (!input) {
+        return 1;
+    }
+
+    std::FILE *out = output_path ? std::fopen(output_path, "w") : stdout;
+    if (!out) {
+        std::println(stderr, "Could not open {}", output_path);
+        return 1;
+    }
+
+    Batch batch(options);
+    Batch::Report report = batch.run(*input, out);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+
+    std::println(stderr, "{} positions, {} nodes in {:.3f} s ({:.1f} positions/s)",
+                 report.positions, report.nodes, report.seconds,
+                 report.positions_per_second());
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // GUIs start the engine without arguments.
+    if (argc < 2 || std::string_view(argv[1]) == "uci") {
+        Uci uci;
+        return uci.run();
+    }
+    if (std::string_view(argv[1]) == "help") {
+        print_usage(argv[0]);
+        return 0;
+    }
+
+    std::string_view mode = argv[1];
+    if (mode == "perft" || mode == "divide" || mode == "perft-suite") {
+        return run_perft(argc, argv);
+    }
+    if (mode == "bench-parallel") {
+        return run_bench_parallel(argc, argv);
+    }
+    if (mode == "bench-fen") {
+        return run_bench_fen(argc, argv);
+    }
+    if (mode == "nnue-check") {
+        return run_nnue_check(argc, argv);
+    }
+    if (mode == "pack") {
+        return run_pack(argc, argv);
+    }
+    if (mode == "batch") {
+        return run_batch(argc, argv);
+    }
+
+    FENParser parser;
+    Board board = parser.parse_fen(util::read_file(argv[1]));
+    board.aggregate();
+
+    Engine::SearchLimits limits;
+    limits.depth = 7;
+    if (argc > 2) {
+      limits.move_time = std::chrono::milliseconds(std::stoi(argv[2]));
+    }
+
+    Engine engine(16, argc > 3 ? std::stoi(argv[3]) : 1);
+    if (argc > 4 && std::string_view(argv[4]) != "-" && engine.load_network(argv[4])) {
+      return 1;
+    }
+    if (argc > 5 && std::string_view(argv[5]) != "-" && engine.load_book(argv[5])) {
+      return 1;
+    }
+    std::optional<Result> result = engine.game_result(board);
+    for (int i = 0; i < 50 && !result; i++) {
+      Engine::SearchResult search = engine.search(board, limits);
+      Engine::Move move = search.move;
+      std::println("Best move: {} -> {} (depth {}, {} nodes, {:.3f} s)",
+                   to_string(move.from), to_string(move.to), search.depth,
+                   search.nodes, search.seconds);
+      if (search.thread_nodes.size() > 1) {
+        for (size_t t = 0; t < search.thread_nodes.size(); t++) {
+          std::println("  thread {}: {} nodes", t, search.thread_nodes[t]);
+        }
+      }
       board = engine.make_move(board, move);
+      result = engine.game_result(board);
     }
 
-    if (board.game_over) {
-      switch (board.result) {
+    TranspositionTable::Stats tt_stats = engine.tt_stats();
+    std::println("TT: {} probes, {} hits ({:.1f}%), {} stores", tt_stats.probes,
+                 tt_stats.hits, 100.0 * tt_stats.hit_rate(), tt_stats.stores);
+    PawnTable::Stats pawn_stats = engine.pawn_stats();
+    std::println("Pawn table: {} probes, {} hits ({:.1f}%)", pawn_stats.probes,
+                 pawn_stats.hits, 100.0 * pawn_stats.hit_rate());
+
+    if (result) {
+      switch (*result) {
       case Result::WhiteWins:
         std::println("White wins!!");
         break;
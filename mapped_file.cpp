@@ -0,0 +1,99 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <print>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::println(stderr, "Could not open {}: {}", path, std::strerror(errno));
+        return nullptr;
+    }
+
+    struct stat info = {};
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        std::println(stderr, "Not a regular file: {}", path);
+        close(fd);
+        return nullptr;
+    }
+
+    // mmap rejects a zero length.
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        close(fd);
+        return std::unique_ptr<MappedFile>(new MappedFile(nullptr, 0));
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference
+    if (data == MAP_FAILED) {
+        std::println(stderr, "Could not map {}: {}", path, std::strerror(errno));
+        return nullptr;
+    }
+
+    // Read front to back: aggressive read-ahead, and pages behind the
+    // reader can be dropped early.
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    return std::unique_ptr<MappedFile>(new MappedFile(static_cast<const char*>(data), size));
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+void MappedFile::will_need(std::string_view range) const {
+    if (range.empty()) {
+        return;
+    }
+
+    // madvise wants a page-aligned start.
+    static const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(range.data()) & ~(page - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(range.data() + range.size());
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+}
+
+void Lines::iterator::next() {
+    if (rest.empty()) {
+        done = true;
+        return;
+    }
+
+    size_t newline = rest.find('\n');
+    line = rest.substr(0, newline);
+    rest = newline == std::string_view::npos ? std::string_view() : rest.substr(newline + 1);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    done = false;
+}
+
+std::vector<std::string_view> partition_lines(std::string_view text, size_t chunk_bytes) {
+    chunk_bytes = std::max<size_t>(chunk_bytes, 1);
+
+    std::vector<std::string_view> chunks;
+    while (!text.empty()) {
+        if (text.size() <= chunk_bytes) {
+            chunks.push_back(text);
+            break;
+        }
+
+        // A line longer than the chunk size makes a chunk of its own.
+        size_t newline = text.find('\n', chunk_bytes - 1);
+        size_t length = newline == std::string_view::npos ? text.size() : newline + 1;
+        chunks.push_back(text.substr(0, length));
+        text.remove_prefix(length);
+    }
+    return chunks;
+}
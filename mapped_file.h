@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A read-only memory mapping of a whole file. The kernel pages it in as it
+// is read, so files far larger than memory can be scanned without copying
+// them onto the heap. Views into it stay valid while the MappedFile lives.
+class MappedFile {
+public:
+    // Returns null, after printing why, if the file cannot be opened or
+    // mapped. An empty file maps to an empty view.
+    static std::unique_ptr<MappedFile> open(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const { return {data, size}; }
+
+    // Asks the kernel to start reading range ahead of use.
+    void will_need(std::string_view range) const;
+
+private:
+    MappedFile(const char* data, size_t size) : data(data), size(size) {}
+
+    const char* data;
+    size_t size;
+};
+
+// Iterates the lines of a text without copying it. Lines end at '\n', a
+// trailing '\r' is dropped and a last line without a newline still counts.
+class Lines {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view*;
+        using reference = std::string_view;
+
+        iterator() = default;
+        explicit iterator(std::string_view rest) : rest(rest) { next(); }
+
+        std::string_view operator*() const { return line; }
+        iterator& operator++() { next(); return *this; }
+        void operator++(int) { next(); }
+
+        bool operator==(const iterator& other) const {
+            return done == other.done && (done || line.data() == other.line.data());
+        }
+
+    private:
+        void next();
+
+        std::string_view rest;
+        std::string_view line;
+        bool done = true;
+    };
+
+    explicit Lines(std::string_view text) : text(text) {}
+
+    iterator begin() const { return iterator(text); }
+    iterator end() const { return iterator(); }
+
+private:
+    std::string_view text;
+};
+
+// Cuts text into consecutive ranges of about chunk_bytes each, every one
+// ending just after a newline (or at the end of the text), so each can be
+// handed to a different thread and read with Lines.
+std::vector<std::string_view> partition_lines(std::string_view text, size_t chunk_bytes);
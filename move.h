@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+#include "board.h"
+
+struct Move {
+    Square from;
+    Square to;
+    PieceType promotion; // left uninitialized so MoveList does not zero its buffer
+
+    bool operator==(const Move& other) const {
+        return from.rank == other.from.rank && from.file == other.from.file &&
+               to.rank == other.to.rank && to.file == other.to.file &&
+               promotion == other.promotion;
+    }
+};
+
+// Fixed-capacity move buffer meant to live on the stack, so searching a
+// node never touches the heap. No position has more than 218 legal moves.
+struct MoveList {
+    std::array<Move, 256> moves;
+    uint16_t count = 0;
+
+    using iterator = decltype(moves.begin());
+    using const_iterator = decltype(moves.cbegin());
+
+    void push_back(const Move& move) {
+        assert(count < moves.size());
+        moves[count++] = move;
+    }
+    void clear() { count = 0; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    Move& operator[](size_t i) { return moves[i]; }
+    const Move& operator[](size_t i) const { return moves[i]; }
+
+    iterator begin() { return moves.begin(); }
+    iterator end() { return moves.begin() + count; }
+    const_iterator begin() const { return moves.cbegin(); }
+    const_iterator end() const { return moves.cbegin() + count; }
+};
+
+inline std::string to_string(const Move &move) {
+  std::string s = to_string(move.from) + to_string(move.to);
+  switch (move.promotion) {
+  case PieceType::Knight:
+    return s + 'n';
+  case PieceType::Bishop:
+    return s + 'b';
+  case PieceType::Rook:
+    return s + 'r';
+  case PieceType::Queen:
+    return s + 'q';
+  default:
+    return s;
+  }
+}
@@ -0,0 +1,84 @@
+#include "movepick.h"
+
+namespace {
+
+constexpr int32_t hash_move_score = 1 << 30;
+constexpr int32_t capture_score = 1 << 24;
+constexpr int32_t killer_score = 1 << 20;
+constexpr int32_t underpromotion_score = -(1 << 20);
+
+} // namespace
+
+MovePicker::MovePicker(const Board& board, MoveList& moves, const Move& hash_move,
+                       const std::array<Move, 2>& killers, const HistoryTable& history)
+    : moves(moves) {
+    Color us = board.turn;
+    Color them = opposite(us);
+
+    for (size_t i = 0; i < moves.size(); i++) {
+        const Move& m = moves[i];
+
+        if (m == hash_move) {
+            scores[i] = hash_move_score;
+            continue;
+        }
+
+        if (m.promotion != PieceType::None && m.promotion != PieceType::Queen) {
+            scores[i] = underpromotion_score;
+            continue;
+        }
+
+        if (is_capture(board, m) || m.promotion == PieceType::Queen) {
+            // Most valuable victim first, least valuable attacker as tiebreak.
+            // An en passant capture finds no piece on the target: a pawn.
+            PieceType victim = board.piece_on(them, m.to.rank * 8 + m.to.file);
+            if (victim == PieceType::None && m.promotion == PieceType::None) {
+                victim = PieceType::Pawn;
+            }
+            PieceType attacker = board.piece_on(us, m.from.rank * 8 + m.from.file);
+            scores[i] = capture_score + static_cast<int32_t>(victim) * 16 -
+                        static_cast<int32_t>(attacker) +
+                        (m.promotion == PieceType::Queen ? 8 * 16 : 0);
+            continue;
+        }
+
+        if (m == killers[0]) {
+            scores[i] = killer_score + 1;
+        } else if (m == killers[1]) {
+            scores[i] = killer_score;
+        } else {
+            scores[i] = history.get(us, m);
+        }
+    }
+}
+
+bool MovePicker::next(Move& move) {
+    if (current >= moves.size()) {
+        return false;
+    }
+
+    size_t best = current;
+    for (size_t i = current + 1; i < moves.size(); i++) {
+        if (scores[i] > scores[best]) {
+            best = i;
+        }
+    }
+
+    std::swap(moves[current], moves[best]);
+    std::swap(scores[current], scores[best]);
+    move = moves[current++];
+    return true;
+}
+
+bool MovePicker::is_capture(const Board& board, const Move& move) {
+    uint8_t to = move.to.rank * 8 + move.to.file;
+    if (board.occupied_squares & (1ULL << to)) {
+        return true;
+    }
+
+    // En passant lands on an empty square.
+    return board.has_en_passant && move.to.rank == board.en_passant_rank &&
+           move.to.file == board.en_passant_file &&
+           (board.white_pawns | board.black_pawns) &
+               (1ULL << (move.from.rank * 8 + move.from.file));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "board.h"
+#include "move.h"
+
+constexpr int max_ply = 128;
+
+// Quiet moves that caused a cutoff at the same ply elsewhere in the tree.
+struct KillerTable {
+    std::array<std::array<Move, 2>, max_ply> killers = {};
+
+    void clear() { killers = {}; }
+
+    void update(int ply, const Move& move) {
+        if (!(killers[ply][0] == move)) {
+            killers[ply][1] = killers[ply][0];
+            killers[ply][0] = move;
+        }
+    }
+};
+
+// Butterfly table of how often a quiet move from -> to caused a cutoff,
+// per side to move.
+struct HistoryTable {
+    static constexpr int32_t max_value = 16384;
+
+    std::array<std::array<std::array<int32_t, 64>, 64>, 2> history = {};
+
+    int32_t get(Color color, const Move& move) const {
+        return history[static_cast<int>(color)][move.from.rank * 8 + move.from.file]
+                      [move.to.rank * 8 + move.to.file];
+    }
+
+    // Pulls the entry towards +/-max_value, so it saturates instead of
+    // overflowing and recent results weigh more.
+    void update(Color color, const Move& move, int32_t bonus) {
+        int32_t& entry = history[static_cast<int>(color)][move.from.rank * 8 + move.from.file]
+                                [move.to.rank * 8 + move.to.file];
+        entry += bonus - entry * (bonus < 0 ? -bonus : bonus) / max_value;
+    }
+
+    // Called between searches so old statistics fade.
+    void age() {
+        for (auto& side : history) {
+            for (auto& from : side) {
+                for (auto& entry : from) {
+                    entry /= 2;
+                }
+            }
+        }
+    }
+};
+
+// Hands out the moves of a node best-first: the hash move, captures by
+// MVV-LVA, killer moves, then quiet moves by history. Moves are scored once
+// and selected lazily, since a cutoff usually comes before the list is done.
+class MovePicker {
+public:
+    MovePicker(const Board& board, MoveList& moves, const Move& hash_move,
+               const std::array<Move, 2>& killers, const HistoryTable& history);
+
+    // Writes the next best move and returns true, or returns false when done.
+    bool next(Move& move);
+
+    static bool is_capture(const Board& board, const Move& move);
+
+private:
+    MoveList& moves;
+    std::array<int32_t, 256> scores;
+    size_t current = 0;
+};
@@ -0,0 +1,261 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <print>
+
+#ifdef CHESS_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+bool Nnue::avx2 = false;
+
+namespace {
+
+// out = in + the added columns - the removed columns.
+void update_columns(int16_t* out, const int16_t* in,
+                    const int16_t* const* added, int added_count,
+                    const int16_t* const* removed, int removed_count) {
+    for (int i = 0; i < Nnue::l1_size; i++) {
+        int16_t value = in[i];
+        for (int a = 0; a < added_count; a++) {
+            value += added[a][i];
+        }
+        for (int r = 0; r < removed_count; r++) {
+            value -= removed[r][i];
+        }
+        out[i] = value;
+    }
+}
+
+int32_t dot(const uint8_t* input, const int8_t* weights, int size) {
+    int32_t sum = 0;
+    for (int i = 0; i < size; i++) {
+        sum += input[i] * weights[i];
+    }
+    return sum;
+}
+
+#ifdef CHESS_HAS_AVX2
+[[gnu::target("avx2")]] void update_columns_avx2(int16_t* out, const int16_t* in,
+                                                 const int16_t* const* added, int added_count,
+                                                 const int16_t* const* removed, int removed_count) {
+    for (int i = 0; i < Nnue::l1_size; i += 16) {
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        for (int a = 0; a < added_count; a++) {
+            value = _mm256_add_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(added[a] + i)));
+        }
+        for (int r = 0; r < removed_count; r++) {
+            value = _mm256_sub_epi16(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(removed[r] + i)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), value);
+    }
+}
+
+// Inputs are at most 127, so the pairwise int16 sums of maddubs cannot
+// saturate and the result matches dot() exactly.
+[[gnu::target("avx2")]] int32_t dot_avx2(const uint8_t* input, const int8_t* weights, int size) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < size; i += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+}
+#endif
+
+template <typename T>
+bool read_array(std::ifstream& file, std::vector<T>& values, size_t count) {
+    values.resize(count);
+    file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+    return !file;
+}
+
+} // namespace
+
+struct NnueInit {
+    NnueInit() {
+#ifdef CHESS_HAS_AVX2
+        __builtin_cpu_init();
+        Nnue::avx2 = __builtin_cpu_supports("avx2");
+#endif
+    }
+};
+
+static NnueInit nnue_init;
+
+void Nnue::set_avx2(bool enabled) {
+#ifdef CHESS_HAS_AVX2
+    avx2 = enabled && __builtin_cpu_supports("avx2");
+#else
+    (void)enabled;
+#endif
+}
+
+std::unique_ptr<Nnue> Nnue::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::println(stderr, "Could not open network file: {}", path);
+        return nullptr;
+    }
+
+    uint32_t header[4] = {};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || header[0] != magic || header[1] != version) {
+        std::println(stderr, "Not a version {} network file: {}", version, path);
+        return nullptr;
+    }
+    if (header[2] != l1_size || header[3] != l2_size) {
+        std::println(stderr, "Network {} has layer sizes {}x{}, expected {}x{}",
+                     path, header[2], header[3], l1_size, l2_size);
+        return nullptr;
+    }
+
+    std::unique_ptr<Nnue> network(new Nnue());
+    std::vector<int32_t> output_bias;
+    if (read_array(file, network->feature_weights, features * l1_size) ||
+        read_array(file, network->feature_bias, l1_size) ||
+        read_array(file, network->hidden_weights, l2_size * 2 * l1_size) ||
+        read_array(file, network->hidden_bias, l2_size) ||
+        read_array(file, network->output_weights, l2_size) ||
+        read_array(file, output_bias, 1)) {
+        std::println(stderr, "Network file is truncated: {}", path);
+        return nullptr;
+    }
+    network->output_bias = output_bias[0];
+
+    if (file.peek() != std::ifstream::traits_type::eof()) {
+        std::println(stderr, "Network file has trailing data: {}", path);
+        return nullptr;
+    }
+
+    return network;
+}
+
+// Each side sees the board from its own end: its pieces come first and
+// black's squares are mirrored.
+int Nnue::feature(Color perspective, Color color, PieceType type, uint8_t square) {
+    int relative_color = color == perspective ? 0 : 1;
+    int relative_square = perspective == Color::White ? square : square ^ 56;
+    return (relative_color * 6 + static_cast<int>(type) - 1) * 64 + relative_square;
+}
+
+Nnue::Delta Nnue::delta(const Board& before, const Move& move) {
+    Delta delta;
+    Color us = before.turn;
+    Color them = opposite(us);
+    uint8_t from = move.from.rank * 8 + move.from.file;
+    uint8_t to = move.to.rank * 8 + move.to.file;
+
+    PieceType moved = before.piece_on(us, from);
+    PieceType placed = move.promotion != PieceType::None ? move.promotion : moved;
+    delta.removed[delta.removed_count++] = {us, moved, from};
+    delta.added[delta.added_count++] = {us, placed, to};
+
+    PieceType captured = before.piece_on(them, to);
+    if (captured != PieceType::None) {
+        delta.removed[delta.removed_count++] = {them, captured, to};
+    } else if (moved == PieceType::Pawn && before.has_en_passant &&
+               move.to.rank == before.en_passant_rank && move.to.file == before.en_passant_file) {
+        delta.removed[delta.removed_count++] = {them, PieceType::Pawn,
+                                                static_cast<uint8_t>(move.from.rank * 8 + move.to.file)};
+    }
+
+    if (moved == PieceType::King && (to == from + 2 || from == to + 2)) {
+        uint8_t rook_from = to > from ? from + 3 : from - 4;
+        uint8_t rook_to = to > from ? from + 1 : from - 1;
+        delta.removed[delta.removed_count++] = {us, PieceType::Rook, rook_from};
+        delta.added[delta.added_count++] = {us, PieceType::Rook, rook_to};
+    }
+
+    return delta;
+}
+
+void Nnue::refresh(Accumulator& accumulator, const Board& board) const {
+    for (Color perspective : {Color::White, Color::Black}) {
+        int16_t* values = accumulator.values[static_cast<int>(perspective)].data();
+        std::copy(feature_bias.begin(), feature_bias.end(), values);
+
+        for (Color color : {Color::White, Color::Black}) {
+            for (int type = static_cast<int>(PieceType::Pawn);
+                 type <= static_cast<int>(PieceType::King); type++) {
+                uint64_t bb = board.pieces(color, static_cast<PieceType>(type));
+                while (bb) {
+                    uint8_t square = static_cast<uint8_t>(std::countr_zero(bb));
+                    const int16_t* column = &feature_weights[
+                        feature(perspective, color, static_cast<PieceType>(type), square) * l1_size];
+#ifdef CHESS_HAS_AVX2
+                    if (avx2) {
+                        update_columns_avx2(values, values, &column, 1, nullptr, 0);
+                    } else
+#endif
+                    update_columns(values, values, &column, 1, nullptr, 0);
+                    bb &= bb - 1;
+                }
+            }
+        }
+    }
+
+    accumulator.key = board.hash;
+    accumulator.computed = true;
+}
+
+void Nnue::update(const Accumulator& parent, Accumulator& child, const Delta& delta) const {
+    for (Color perspective : {Color::White, Color::Black}) {
+        const int16_t* added[2];
+        const int16_t* removed[2];
+        for (int i = 0; i < delta.added_count; i++) {
+            const Delta::Piece& piece = delta.added[i];
+            added[i] = &feature_weights[feature(perspective, piece.color, piece.type, piece.square) * l1_size];
+        }
+        for (int i = 0; i < delta.removed_count; i++) {
+            const Delta::Piece& piece = delta.removed[i];
+            removed[i] = &feature_weights[feature(perspective, piece.color, piece.type, piece.square) * l1_size];
+        }
+
+        int side = static_cast<int>(perspective);
+#ifdef CHESS_HAS_AVX2
+        if (avx2) {
+            update_columns_avx2(child.values[side].data(), parent.values[side].data(),
+                                added, delta.added_count, removed, delta.removed_count);
+            continue;
+        }
+#endif
+        update_columns(child.values[side].data(), parent.values[side].data(),
+                       added, delta.added_count, removed, delta.removed_count);
+    }
+    child.computed = true;
+}
+
+int32_t Nnue::evaluate(const Accumulator& accumulator, Color side_to_move) const {
+    alignas(32) uint8_t input[2 * l1_size];
+    const auto& ours = accumulator.values[static_cast<int>(side_to_move)];
+    const auto& theirs = accumulator.values[static_cast<int>(opposite(side_to_move))];
+    for (int i = 0; i < l1_size; i++) {
+        input[i] = static_cast<uint8_t>(std::clamp<int16_t>(ours[i], 0, 127));
+        input[l1_size + i] = static_cast<uint8_t>(std::clamp<int16_t>(theirs[i], 0, 127));
+    }
+
+    int32_t output = output_bias;
+    for (int j = 0; j < l2_size; j++) {
+        const int8_t* weights = &hidden_weights[j * 2 * l1_size];
+        int32_t sum;
+#ifdef CHESS_HAS_AVX2
+        if (avx2) {
+            sum = dot_avx2(input, weights, 2 * l1_size);
+        } else
+#endif
+        sum = dot(input, weights, 2 * l1_size);
+
+        int32_t hidden = std::clamp((hidden_bias[j] + sum) >> hidden_shift, 0, 127);
+        output += hidden * output_weights[j];
+    }
+
+    return output / output_divisor;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "move.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHESS_HAS_AVX2 1
+#endif
+
+// Efficiently updatable neural network evaluation.
+//
+// Input is one feature per (color, piece, square) seen from each side, so
+// 768 per perspective. The first layer is kept per perspective as an
+// int16 accumulator; a move only adds and subtracts the weight columns of
+// the few pieces it touches. The two accumulators, side to move first, are
+// clipped to 0..127 and fed through an int8 hidden layer and an int8
+// output layer. AVX2 kernels are used when the CPU has them (checked once
+// at startup) and give the same results as the portable ones.
+//
+// File layout, little-endian:
+//   uint32 magic "NNUE", uint32 version, uint32 l1_size, uint32 l2_size
+//   int16 feature_weights[768][l1_size], int16 feature_bias[l1_size]
+//   int8  hidden_weights[l2_size][2 * l1_size], int32 hidden_bias[l2_size]
+//   int8  output_weights[l2_size], int32 output_bias
+// Hidden sums are shifted right by hidden_shift before clipping and the
+// output sum is divided by output_divisor to give centipawns.
+class Nnue {
+public:
+    static constexpr uint32_t magic = 0x45554E4E; // "NNUE"
+    static constexpr uint32_t version = 1;
+    static constexpr int features = 768;
+    static constexpr int l1_size = 256;
+    static constexpr int l2_size = 32;
+    static constexpr int hidden_shift = 6;
+    static constexpr int output_divisor = 16;
+
+    struct alignas(32) Accumulator {
+        std::array<std::array<int16_t, l1_size>, 2> values; // [perspective]
+        uint64_t key = 0; // Board::hash of the position it was built for
+        bool computed = false;
+    };
+
+    // Pieces a move adds to and removes from the board.
+    struct Delta {
+        struct Piece {
+            Color color;
+            PieceType type;
+            uint8_t square;
+        };
+
+        std::array<Piece, 2> added;
+        std::array<Piece, 2> removed;
+        uint8_t added_count = 0;
+        uint8_t removed_count = 0;
+    };
+
+    // Returns null, after printing why, if the file is missing or malformed.
+    static std::unique_ptr<Nnue> load(const std::string& path);
+
+    static Delta delta(const Board& before, const Move& move);
+
+    void refresh(Accumulator& accumulator, const Board& board) const;
+    void update(const Accumulator& parent, Accumulator& child, const Delta& delta) const;
+
+    // Centipawns from the side to move's point of view.
+    int32_t evaluate(const Accumulator& accumulator, Color side_to_move) const;
+
+    static bool uses_avx2() { return avx2; }
+
+    // For comparing the two paths (see nnue-check in main.cpp); not to be
+    // called during a search.
+    static void set_avx2(bool enabled);
+
+private:
+    Nnue() = default;
+
+    static int feature(Color perspective, Color color, PieceType type, uint8_t square);
+
+    std::vector<int16_t> feature_weights; // [features][l1_size]
+    std::vector<int16_t> feature_bias;    // [l1_size]
+    std::vector<int8_t> hidden_weights;   // [l2_size][2 * l1_size]
+    std::vector<int32_t> hidden_bias;     // [l2_size]
+    std::vector<int8_t> output_weights;   // [l2_size]
+    int32_t output_bias = 0;
+
+    static bool avx2;
+    friend struct NnueInit;
+};
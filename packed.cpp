@@ -0,0 +1,179 @@
+#include "packed.h"
+#include "eval.h"
+#include "zobrist.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <print>
+
+// Records are written and mapped back as they sit in memory.
+static_assert(std::endian::native == std::endian::little);
+
+bool PackedFormat::encode(const Board& board, PackedBoard& packed) {
+    uint64_t occupied = board.white_pieces | board.black_pieces;
+    if (std::popcount(occupied) > 32) {
+        return true;
+    }
+
+    packed = PackedBoard{};
+    packed.occupied = occupied;
+
+    int index = 0;
+    for (uint64_t rest = occupied; rest; rest &= rest - 1) {
+        uint8_t square = static_cast<uint8_t>(std::countr_zero(rest));
+        Color color = board.white_pieces & (1ULL << square) ? Color::White : Color::Black;
+        uint8_t nibble = static_cast<uint8_t>(board.piece_on(color, square)) |
+                         static_cast<uint8_t>(static_cast<int>(color) << 3);
+        packed.pieces[index / 2] |= static_cast<uint8_t>(nibble << (index % 2 * 4));
+        index++;
+    }
+
+    packed.flags = (board.turn == Color::Black ? PackedBoard::black_to_move : 0) |
+                   (board.castle_white_kingside ? PackedBoard::castle_white_kingside : 0) |
+                   (board.castle_white_queenside ? PackedBoard::castle_white_queenside : 0) |
+                   (board.castle_black_kingside ? PackedBoard::castle_black_kingside : 0) |
+                   (board.castle_black_queenside ? PackedBoard::castle_black_queenside : 0);
+    if (board.has_en_passant) {
+        packed.en_passant = static_cast<uint8_t>(board.en_passant_rank * 8 + board.en_passant_file);
+    }
+    packed.half_move = board.half_move;
+    packed.full_move = board.full_move;
+    return false;
+}
+
+bool PackedFormat::decode(const PackedBoard& packed, Board& board) {
+    if (std::popcount(packed.occupied) > 32 || packed.flags >> 5 != 0 ||
+        (packed.en_passant != PackedBoard::no_en_passant && packed.en_passant >= 64)) {
+        return true;
+    }
+
+    board = Board{};
+    int index = 0;
+    for (uint64_t rest = packed.occupied; rest; rest &= rest - 1) {
+        uint8_t nibble = (packed.pieces[index / 2] >> (index % 2 * 4)) & 0xf;
+        uint8_t type = nibble & 7;
+        if (type < static_cast<uint8_t>(PieceType::Pawn) || type > static_cast<uint8_t>(PieceType::King)) {
+            return true;
+        }
+        Color color = nibble & 8 ? Color::Black : Color::White;
+        board.pieces(color, static_cast<PieceType>(type)) |= 1ULL << std::countr_zero(rest);
+        index++;
+    }
+
+    board.turn = packed.flags & PackedBoard::black_to_move ? Color::Black : Color::White;
+    board.castle_white_kingside = packed.flags & PackedBoard::castle_white_kingside;
+    board.castle_white_queenside = packed.flags & PackedBoard::castle_white_queenside;
+    board.castle_black_kingside = packed.flags & PackedBoard::castle_black_kingside;
+    board.castle_black_queenside = packed.flags & PackedBoard::castle_black_queenside;
+    if (packed.en_passant != PackedBoard::no_en_passant) {
+        board.has_en_passant = true;
+        board.en_passant_file = packed.en_passant % 8;
+        board.en_passant_rank = packed.en_passant / 8;
+    }
+    board.half_move = packed.half_move;
+    board.full_move = packed.full_move;
+
+    board.aggregate();
+    board.hash = Zobrist::compute(board);
+    board.pawn_key = Zobrist::compute_pawns(board);
+    board.psq = Evaluation::compute_piece_squares(board);
+    board.phase = Evaluation::compute_phase(board);
+    return false;
+}
+
+size_t PackedFormat::encode(std::span<const Board> boards, std::span<PackedBoard> packed) {
+    size_t count = std::min(boards.size(), packed.size());
+    for (size_t i = 0; i < count; i++) {
+        if (encode(boards[i], packed[i])) {
+            return i;
+        }
+    }
+    return count;
+}
+
+size_t PackedFormat::decode(std::span<const PackedBoard> packed, std::span<Board> boards) {
+    size_t count = std::min(packed.size(), boards.size());
+    for (size_t i = 0; i < count; i++) {
+        if (decode(packed[i], boards[i])) {
+            return i;
+        }
+    }
+    return count;
+}
+
+std::unique_ptr<PackedWriter> PackedWriter::create(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::println(stderr, "Could not create {}: {}", path, std::strerror(errno));
+        return nullptr;
+    }
+
+    std::unique_ptr<PackedWriter> writer(new PackedWriter(file, path));
+    // A placeholder until finish knows the count.
+    if (std::fwrite(&writer->header, sizeof(PackedHeader), 1, file) != 1) {
+        std::println(stderr, "Could not write {}", path);
+        return nullptr;
+    }
+    return writer;
+}
+
+PackedWriter::~PackedWriter() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool PackedWriter::write(std::span<const PackedBoard> records) {
+    if (std::fwrite(records.data(), sizeof(PackedBoard), records.size(), file) != records.size()) {
+        std::println(stderr, "Could not write {}", path);
+        return true;
+    }
+    header.count += records.size();
+    return false;
+}
+
+bool PackedWriter::finish() {
+    bool failed = std::fseek(file, 0, SEEK_SET) != 0 ||
+                  std::fwrite(&header, sizeof(PackedHeader), 1, file) != 1;
+    failed |= std::fclose(file) != 0;
+    file = nullptr;
+    if (failed) {
+        std::println(stderr, "Could not write {}", path);
+    }
+    return failed;
+}
+
+std::unique_ptr<PackedFile> PackedFile::open(const std::string& path) {
+    std::unique_ptr<MappedFile> mapping = MappedFile::open(path);
+    if (!mapping) {
+        return nullptr;
+    }
+
+    std::string_view bytes = mapping->view();
+    PackedHeader header;
+    if (bytes.size() < sizeof(PackedHeader)) {
+        std::println(stderr, "Not a packed position file: {}", path);
+        return nullptr;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(PackedHeader));
+    if (header.magic != PackedHeader::magic_value || header.version != PackedHeader::current_version ||
+        header.record_size != sizeof(PackedBoard)) {
+        std::println(stderr, "Not a version {} packed position file: {}",
+                     PackedHeader::current_version, path);
+        return nullptr;
+    }
+    if ((bytes.size() - sizeof(PackedHeader)) / sizeof(PackedBoard) != header.count ||
+        (bytes.size() - sizeof(PackedHeader)) % sizeof(PackedBoard) != 0) {
+        std::println(stderr, "Packed position file {} should hold {} records", path, header.count);
+        return nullptr;
+    }
+
+    // The mapping is page aligned and the header keeps the records 16-byte
+    // aligned, so they can be used in place.
+    std::unique_ptr<PackedFile> file(new PackedFile(std::move(mapping)));
+    file->records_view = {reinterpret_cast<const PackedBoard*>(bytes.data() + sizeof(PackedHeader)),
+                          header.count};
+    return file;
+}
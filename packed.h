@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+
+#include "board.h"
+#include "mapped_file.h"
+
+// A position in 32 bytes. The pieces are listed in square order (a1, b1,
+// ..., h8) as one nibble each, low nibble first: bit 3 is the color and the
+// low three bits the PieceType. A legal position has at most 32 pieces.
+struct PackedBoard {
+    static constexpr uint8_t black_to_move = 1 << 0;
+    static constexpr uint8_t castle_white_kingside = 1 << 1;
+    static constexpr uint8_t castle_white_queenside = 1 << 2;
+    static constexpr uint8_t castle_black_kingside = 1 << 3;
+    static constexpr uint8_t castle_black_queenside = 1 << 4;
+    static constexpr uint8_t no_en_passant = 0xff;
+
+    uint64_t occupied = 0;
+    uint8_t pieces[16] = {};
+    uint8_t flags = 0;
+    uint8_t en_passant = no_en_passant; // square index
+    uint16_t half_move = 0;
+    uint16_t full_move = 1;
+    uint8_t reserved[2] = {};
+};
+
+static_assert(sizeof(PackedBoard) == 32);
+
+class PackedFormat {
+public:
+    // The board must be aggregated. Returns true if it has more than 32
+    // pieces.
+    static bool encode(const Board& board, PackedBoard& packed);
+
+    // Returns true if the record is malformed. The board comes back
+    // aggregated, with its hash and evaluation terms set, as from FENParser.
+    static bool decode(const PackedBoard& packed, Board& board);
+
+    // Convert min(in.size(), out.size()) positions, stopping at the first
+    // one that fails. Return how many were converted.
+    static size_t encode(std::span<const Board> boards, std::span<PackedBoard> packed);
+    static size_t decode(std::span<const PackedBoard> packed, std::span<Board> boards);
+};
+
+// File layout: a 16-byte header (magic "CPOS", version, record size and
+// record count) followed by the records, little-endian as in memory.
+struct PackedHeader {
+    static constexpr uint32_t magic_value = 0x534f5043; // "CPOS"
+    static constexpr uint16_t current_version = 2; // 1 had 8-bit move counters
+
+    uint32_t magic = magic_value;
+    uint16_t version = current_version;
+    uint16_t record_size = sizeof(PackedBoard);
+    uint64_t count = 0;
+};
+
+static_assert(sizeof(PackedHeader) == 16);
+
+// Appends records to a new file and fills in the header count on finish.
+class PackedWriter {
+public:
+    // Returns null, after printing why, if the file cannot be created.
+    static std::unique_ptr<PackedWriter> create(const std::string& path);
+
+    ~PackedWriter();
+
+    PackedWriter(const PackedWriter&) = delete;
+    PackedWriter& operator=(const PackedWriter&) = delete;
+
+    // Both return true, after printing why, on a write error.
+    bool write(std::span<const PackedBoard> records);
+    bool finish();
+
+    uint64_t count() const { return header.count; }
+
+private:
+    PackedWriter(std::FILE* file, std::string path) : file(file), path(std::move(path)) {}
+
+    std::FILE* file;
+    std::string path;
+    PackedHeader header;
+};
+
+// Reads a packed file in place through a memory mapping.
+class PackedFile {
+public:
+    // Returns null, after printing why, if the file is missing or its
+    // header does not match its size.
+    static std::unique_ptr<PackedFile> open(const std::string& path);
+
+    std::span<const PackedBoard> records() const { return records_view; }
+
+private:
+    explicit PackedFile(std::unique_ptr<MappedFile> file) : file(std::move(file)) {}
+
+    std::unique_ptr<MappedFile> file;
+    std::span<const PackedBoard> records_view;
+};
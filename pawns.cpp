@@ -0,0 +1,24 @@
+#include "pawns.h"
+
+#include <bit>
+
+Score PawnTable::probe(const Board& board) {
+    Entry& entry = entries[board.pawn_key & (entry_count - 1)];
+    counts.probes++;
+    if (entry.key == board.pawn_key) {
+        counts.hits++;
+    } else {
+        entry.key = board.pawn_key;
+        entry.structure = Evaluation::pawn_structure(board);
+        entry.white_king = no_square;
+    }
+
+    uint8_t white_king = static_cast<uint8_t>(std::countr_zero(board.white_kings));
+    uint8_t black_king = static_cast<uint8_t>(std::countr_zero(board.black_kings));
+    if (entry.white_king != white_king || entry.black_king != black_king) {
+        entry.shield = Evaluation::pawn_shield(board);
+        entry.white_king = white_king;
+        entry.black_king = black_king;
+    }
+    return entry.structure + entry.shield;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "board.h"
+#include "eval.h"
+
+// Hash table of pawn evaluation keyed on Board::pawn_key. The pawns change
+// only on pawn moves and captures, so most positions a search visits share
+// their structure with one it has already seen. Each search thread has its
+// own table, so there is no locking.
+//
+// The king shield also depends on where the kings stand. An entry keeps
+// the king squares it was computed for, and only the shield is redone when
+// a king has moved.
+class PawnTable {
+public:
+    struct Stats {
+        uint64_t probes = 0;
+        uint64_t hits = 0;
+
+        double hit_rate() const { return probes ? static_cast<double>(hits) / probes : 0.0; }
+
+        Stats &operator+=(const Stats &other) {
+            probes += other.probes;
+            hits += other.hits;
+            return *this;
+        }
+    };
+
+    static constexpr size_t entry_count = 1 << 14;
+
+    PawnTable() : entries(std::make_unique<Entry[]>(entry_count)) {}
+
+    // Evaluation::pawn_structure plus Evaluation::pawn_shield.
+    Score probe(const Board& board);
+
+    const Stats& stats() const { return counts; }
+
+private:
+    static constexpr uint8_t no_square = 64;
+
+    // An unused entry has key 0 and no structure terms, which is right for a
+    // position without pawns.
+    struct Entry {
+        uint64_t key = 0;
+        Score structure = 0;
+        Score shield = 0;
+        uint8_t white_king = no_square;
+        uint8_t black_king = no_square;
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    Stats counts;
+};
@@ -0,0 +1,111 @@
+#include "perft.h"
+
+#include <chrono>
+#include <print>
+
+#include "fen.h"
+
+uint64_t Perft::perft(const Board &board, int depth) {
+  Board b = board;
+  return perft_in_place(b, depth);
+}
+
+uint64_t Perft::perft_in_place(Board &board, int depth) {
+  if (depth == 0) {
+    return 1;
+  }
+
+  Engine::MoveList moves;
+  engine.generate_moves(board, moves);
+
+  if (depth == 1) {
+    return moves.size();
+  }
+
+  uint64_t nodes = 0;
+  Engine::Undo undo;
+  for (const auto &m : moves) {
+    engine.do_move(board, m, undo);
+    nodes += perft_in_place(board, depth - 1);
+    engine.undo_move(board, m, undo);
+  }
+  return nodes;
+}
+
+Perft::Report Perft::run(const Board &board, int depth) {
+  auto start = std::chrono::steady_clock::now();
+
+  Report report;
+  report.nodes = perft(board, depth);
+  report.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return report;
+}
+
+Perft::Report Perft::divide(const Board &board, int depth) {
+  auto start = std::chrono::steady_clock::now();
+
+  Engine::MoveList moves;
+  engine.generate_moves(board, moves);
+
+  Report report;
+  Board b = board;
+  Engine::Undo undo;
+  for (const auto &m : moves) {
+    engine.do_move(b, m, undo);
+    uint64_t nodes = perft_in_place(b, depth - 1);
+    engine.undo_move(b, m, undo);
+    std::println("{}: {}", to_string(m), nodes);
+    report.nodes += nodes;
+  }
+
+  report.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return report;
+}
+
+bool Perft::run_suite(int max_depth) {
+  FENParser parser;
+  bool failed = false;
+
+  for (const auto &position : reference_positions()) {
+    std::println("{}", position.fen);
+
+    Board board = parser.parse_fen(position.fen);
+    board.aggregate();
+
+    for (int depth = 1; depth <= max_depth && depth <= static_cast<int>(position.nodes.size()); depth++) {
+      Report report = run(board, depth);
+      uint64_t expected = position.nodes[depth - 1];
+      bool ok = report.nodes == expected;
+      failed |= !ok;
+
+      std::println("  depth {} nodes {:>10} expected {:>10} {:>12.0f} nps {}",
+                   depth, report.nodes, expected, report.nps(),
+                   ok ? "ok" : "FAIL");
+    }
+  }
+
+  return failed;
+}
+
+// Reference counts from the chessprogramming wiki perft results page.
+const std::vector<Perft::Position> &Perft::reference_positions() {
+  static const std::vector<Position> positions = {
+      {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+       {20, 400, 8902, 197281, 4865609}},
+      {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+       {48, 2039, 97862, 4085603}},
+      {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+       {14, 191, 2812, 43238, 674624}},
+      {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+       {6, 264, 9467, 422333}},
+      {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+       {44, 1486, 62379, 2103487}},
+      {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+       {46, 2079, 89890, 3894594}},
+  };
+  return positions;
+}
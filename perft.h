@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "engine.h"
+
+// Counts the leaf nodes of the legal move tree, the standard way to check a
+// move generator against known reference numbers.
+class Perft {
+public:
+  struct Position {
+    std::string fen;
+    std::vector<uint64_t> nodes; // nodes[i] is the reference count at depth i+1
+  };
+
+  struct Report {
+    uint64_t nodes = 0;
+    double seconds = 0.0;
+
+    double nps() const { return seconds > 0.0 ? nodes / seconds : 0.0; }
+  };
+
+  explicit Perft(Engine &engine) : engine(engine) {}
+
+  uint64_t perft(const Board &board, int depth);
+
+  Report run(const Board &board, int depth);
+  Report divide(const Board &board, int depth);
+
+  // Runs every reference position up to max_depth. Returns true on mismatch.
+  bool run_suite(int max_depth);
+
+  static const std::vector<Position> &reference_positions();
+
+private:
+  uint64_t perft_in_place(Board &board, int depth);
+
+  Engine &engine;
+};
@@ -0,0 +1,67 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(size_t workers) {
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (size_t i = 1; i < queues.size(); i++) {
+        threads.emplace_back([this, i] {
+            while (!shutdown.load(std::memory_order_relaxed)) {
+                if (!run_one(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    shutdown = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::push(size_t worker, Task task) {
+    Queue& queue = *queues[worker];
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+}
+
+bool WorkStealingPool::run_one(size_t worker) {
+    Task task;
+    if (!pop(worker, task) && !steal(worker, task)) {
+        return false;
+    }
+    task(worker);
+    return true;
+}
+
+bool WorkStealingPool::pop(size_t worker, Task& task) {
+    Queue& queue = *queues[worker];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t worker, Task& task) {
+    // Start at a different victim per worker so thieves do not all contend
+    // for the same deque.
+    for (size_t i = 1; i < queues.size(); i++) {
+        Queue& queue = *queues[(worker + i) % queues.size()];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: each worker owns a deque, pushes and pops its own work
+// at the back and steals from the front of the others'. Worker 0 is the
+// thread that owns the pool and only takes part while it waits in run_one.
+class WorkStealingPool {
+public:
+    using Task = std::function<void(size_t worker)>;
+
+    explicit WorkStealingPool(size_t workers);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void push(size_t worker, Task task);
+
+    // Runs one task, from the worker's own deque if it has any, otherwise
+    // stolen from another worker. Returns false if no work was found.
+    bool run_one(size_t worker);
+
+    size_t size() const { return queues.size(); }
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(size_t worker, Task& task);
+    bool steal(size_t worker, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<bool> shutdown = false;
+};
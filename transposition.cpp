@@ -0,0 +1,132 @@
+#include "transposition.h"
+
+#include <algorithm>
+#include <bit>
+
+TranspositionTable::TranspositionTable(size_t size_mb) {
+    resize(size_mb);
+}
+
+void TranspositionTable::resize(size_t size_mb) {
+    // Round down to a power of two so the bucket index is a mask.
+    size_t count = std::max<size_t>(1, size_mb * 1024 * 1024 / sizeof(Bucket));
+    bucket_count = std::bit_floor(count);
+    buckets = std::make_unique<Bucket[]>(bucket_count);
+    generation = 0;
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i < bucket_count; i++) {
+        for (Slot &slot : buckets[i].slots) {
+            slot.key_xor_data.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    generation = 0;
+}
+
+void TranspositionTable::new_search() {
+    generation = (generation + 1) & 0x3F;
+}
+
+uint64_t TranspositionTable::pack(const Entry &entry) {
+    return static_cast<uint64_t>(std::bit_cast<uint32_t>(entry.score)) |
+           (static_cast<uint64_t>(entry.move) << 32) |
+           (static_cast<uint64_t>(static_cast<uint8_t>(entry.depth)) << 48) |
+           (static_cast<uint64_t>(entry.bound_generation) << 56);
+}
+
+TranspositionTable::Entry TranspositionTable::unpack(uint64_t data) {
+    Entry entry;
+    entry.score = std::bit_cast<int32_t>(static_cast<uint32_t>(data));
+    entry.move = static_cast<uint16_t>(data >> 32);
+    entry.depth = static_cast<int8_t>(data >> 48);
+    entry.bound_generation = static_cast<uint8_t>(data >> 56);
+    return entry;
+}
+
+bool TranspositionTable::probe(uint64_t key, Entry &entry) {
+    for (Slot &slot : bucket_for(key).slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t key_xor_data = slot.key_xor_data.load(std::memory_order_relaxed);
+        if ((key_xor_data ^ data) != key || data == 0) {
+            continue;
+        }
+
+        entry = unpack(data);
+
+        // Refresh the age so entries still in use are kept.
+        if (entry.generation() != generation) {
+            entry.bound_generation = static_cast<uint8_t>((generation << 2) | (entry.bound_generation & 0x3));
+            uint64_t refreshed = pack(entry);
+            slot.data.store(refreshed, std::memory_order_relaxed);
+            slot.key_xor_data.store(key ^ refreshed, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, int32_t score, uint16_t move, int depth, Bound bound) {
+    Bucket &bucket = bucket_for(key);
+
+    // Reuse the slot of the same position if present, otherwise evict the
+    // entry with the lowest depth, counting each search of age as 8 plies.
+    Slot *replace = &bucket.slots[0];
+    Entry old;
+    bool same_position = false;
+    int replace_value = 1 << 30;
+    for (Slot &slot : bucket.slots) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t key_xor_data = slot.key_xor_data.load(std::memory_order_relaxed);
+        Entry e = unpack(data);
+
+        if (data == 0 || (key_xor_data ^ data) == key) {
+            replace = &slot;
+            old = e;
+            same_position = data != 0;
+            break;
+        }
+
+        int age = (generation - e.generation()) & 0x3F;
+        int value = e.depth - 8 * age;
+        if (value < replace_value) {
+            replace_value = value;
+            replace = &slot;
+        }
+    }
+
+    // Do not let a shallow result overwrite a deeper one for the same
+    // position unless it is exact, keeping the old move if there is no new one.
+    if (same_position) {
+        if (bound != Bound::Exact && depth < old.depth - 2) {
+            return;
+        }
+        if (move == 0) {
+            move = old.move;
+        }
+    }
+
+    Entry entry;
+    entry.score = score;
+    entry.move = move;
+    entry.depth = static_cast<int8_t>(depth);
+    entry.bound_generation = static_cast<uint8_t>((generation << 2) | static_cast<uint8_t>(bound));
+
+    uint64_t data = pack(entry);
+    replace->data.store(data, std::memory_order_relaxed);
+    replace->key_xor_data.store(key ^ data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+    size_t sample = std::min<size_t>(bucket_count, 1000 / bucket_size);
+    int used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        for (const Slot &slot : buckets[i].slots) {
+            uint64_t data = slot.data.load(std::memory_order_relaxed);
+            used += data != 0 && unpack(data).generation() == generation;
+        }
+    }
+    return sample ? used * 1000 / static_cast<int>(sample * bucket_size) : 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Fixed-size hash table of search results keyed on Board::hash. Entries are
+// grouped into cache-line buckets so a probe touches a single line.
+//
+// The table is shared by all search threads without locks. Each slot is two
+// 64-bit words, the data and the key XOR the data. A slot torn by two
+// concurrent writers no longer XORs back to its key and reads as a miss.
+class TranspositionTable {
+public:
+    enum class Bound : uint8_t {
+        None = 0,
+        Exact = 1,
+        Lower = 2, // score is at least this (fail high)
+        Upper = 3, // score is at most this (fail low)
+    };
+
+    struct Entry {
+        int32_t score = 0;
+        uint16_t move = 0; // packed from | to << 6 | promotion << 12, 0 if none
+        int8_t depth = 0;
+        uint8_t bound_generation = 0; // bound in the low 2 bits, generation above
+
+        Bound bound() const { return static_cast<Bound>(bound_generation & 0x3); }
+        uint8_t generation() const { return bound_generation >> 2; }
+    };
+
+    struct Slot {
+        std::atomic<uint64_t> key_xor_data = 0;
+        std::atomic<uint64_t> data = 0;
+    };
+
+    static constexpr size_t bucket_size = 4;
+
+    struct alignas(64) Bucket {
+        Slot slots[bucket_size];
+    };
+
+    // Counted by the callers, one set per search thread, so probing does not
+    // write to a shared cache line.
+    struct Stats {
+        uint64_t probes = 0;
+        uint64_t hits = 0;
+        uint64_t stores = 0;
+
+        double hit_rate() const { return probes ? static_cast<double>(hits) / probes : 0.0; }
+
+        Stats &operator+=(const Stats &other) {
+            probes += other.probes;
+            hits += other.hits;
+            stores += other.stores;
+            return *this;
+        }
+    };
+
+    explicit TranspositionTable(size_t size_mb);
+
+    void resize(size_t size_mb);
+    void clear();
+
+    // Ages the table; entries from older searches are replaced first. Must
+    // not run concurrently with a search.
+    void new_search();
+
+    // Copies the entry for key into entry and returns true on a hit.
+    bool probe(uint64_t key, Entry &entry);
+
+    void store(uint64_t key, int32_t score, uint16_t move, int depth, Bound bound);
+
+    // Permille of sampled entries written during the current search.
+    int hashfull() const;
+
+private:
+    static uint64_t pack(const Entry &entry);
+    static Entry unpack(uint64_t data);
+
+    Bucket &bucket_for(uint64_t key) {
+        return buckets[key & (bucket_count - 1)];
+    }
+
+    std::unique_ptr<Bucket[]> buckets;
+    size_t bucket_count = 0;
+    uint8_t generation = 0;
+};
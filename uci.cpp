@@ -0,0 +1,320 @@
+#include "uci.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <print>
+#include <string>
+#include <string_view>
+
+#include "eval.h"
+#include "fen.h"
+
+static constexpr const char *start_fen =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Parses a whole non-negative number. Returns true on failure.
+static bool parse_number(const std::string &text, uint64_t &value) {
+  auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+  return error != std::errc() || end != text.data() + text.size();
+}
+
+static constexpr std::string_view go_value_keys[] = {
+    "wtime", "btime", "winc", "binc", "movestogo", "depth", "nodes", "mate", "movetime",
+};
+
+// Whether a go parameter is followed by a number.
+static bool takes_value(const std::string &token) {
+  return std::ranges::find(go_value_keys, token) != std::end(go_value_keys);
+}
+
+// Whether a token starts a new go parameter, which ends a searchmoves list.
+static bool is_go_keyword(const std::string &token) {
+  return takes_value(token) || token == "searchmoves" || token == "ponder" || token == "infinite";
+}
+
+Uci::Uci() {
+  FENParser parser;
+  board = parser.parse_fen(start_fen);
+  board.aggregate();
+
+  engine.set_info_callback([this](const Engine::SearchResult &result) {
+    print_info(result);
+  });
+}
+
+Uci::~Uci() { stop_search(); }
+
+int Uci::run(std::istream &in) {
+  // GUIs read our output line by line through a pipe.
+  std::setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream args(line);
+    std::string command;
+    args >> command;
+
+    if (command == "uci") {
+      std::println("id name chess");
+      std::println("id author johansolbakken");
+      std::println("option name Hash type spin default 16 min 1 max 65536");
+      std::println("option name Threads type spin default 1 min 1 max 256");
+      std::println("option name EvalFile type string default <empty>");
+      std::println("option name BookFile type string default <empty>");
+      std::println("option name Ponder type check default false");
+      std::println("uciok");
+    } else if (command == "isready") {
+      std::println("readyok");
+    } else if (command == "ucinewgame") {
+      stop_search();
+      engine.transposition_table().clear();
+    } else if (command == "position") {
+      stop_search();
+      position(args);
+    } else if (command == "go") {
+      stop_search();
+      go(args);
+    } else if (command == "stop") {
+      stop_search();
+    } else if (command == "ponderhit") {
+      ponder_hit_received();
+    } else if (command == "setoption") {
+      stop_search();
+      set_option(args);
+    } else if (command == "quit") {
+      break;
+    } else if (!command.empty()) {
+      std::println("info string unknown command {}", command);
+    }
+  }
+
+  stop_search();
+  return 0;
+}
+
+// position startpos [moves ...] | position fen <fen> [moves ...]
+void Uci::position(std::istringstream &args) {
+  std::string token;
+  std::string fen;
+  args >> token;
+  if (token == "startpos") {
+    fen = start_fen;
+    args >> token;
+  } else if (token == "fen") {
+    while (args >> token && token != "moves") {
+      fen += fen.empty() ? token : " " + token;
+    }
+  } else {
+    std::println("info string expected startpos or fen");
+    return;
+  }
+
+  FENParser parser;
+  std::expected<Board, FenError> parsed = parser.parse(fen);
+  if (!parsed) {
+    std::println("info string invalid fen: {} at offset {}",
+                 to_string(parsed.error().kind), parsed.error().offset);
+    return;
+  }
+  board = *parsed;
+
+  if (token != "moves") {
+    return;
+  }
+
+  std::string text;
+  while (args >> text) {
+    Engine::MoveList moves;
+    engine.generate_moves(board, moves);
+    auto move = std::find_if(moves.begin(), moves.end(), [&](const Move &m) {
+      return to_string(m) == text;
+    });
+    if (move == moves.end()) {
+      std::println("info string illegal move {}", text);
+      return;
+    }
+    board = engine.make_move(board, *move);
+  }
+}
+
+void Uci::go(std::istringstream &args) {
+  using std::chrono::milliseconds;
+
+  Engine::SearchLimits limits;
+  bool infinite = false;
+  bool ponder = false;
+  bool white = board.turn == Color::White;
+
+  std::string token;
+  bool have_token = false;
+  while (have_token || args >> token) {
+    have_token = false;
+    if (token == "infinite") {
+      infinite = true;
+      continue;
+    }
+    if (token == "ponder") {
+      ponder = true;
+      continue;
+    }
+    if (token == "searchmoves") {
+      // Restricting the root moves is not supported; skip the list up to
+      // the next parameter.
+      while (args >> token && !is_go_keyword(token)) {
+      }
+      have_token = is_go_keyword(token);
+      continue;
+    }
+    if (!takes_value(token)) {
+      continue;
+    }
+
+    std::string text;
+    uint64_t value = 0;
+    if (!(args >> text) || parse_number(text, value)) {
+      continue;
+    }
+
+    if (token == (white ? "wtime" : "btime")) {
+      limits.time_left = milliseconds(std::max<uint64_t>(value, 1));
+    } else if (token == (white ? "winc" : "binc")) {
+      limits.increment = milliseconds(value);
+    } else if (token == "movestogo") {
+      limits.moves_to_go = static_cast<int>(std::min<uint64_t>(value, 1000));
+    } else if (token == "movetime") {
+      limits.move_time = milliseconds(std::max<uint64_t>(value, 1));
+    } else if (token == "nodes") {
+      limits.nodes = value;
+    } else if (token == "depth") {
+      limits.depth = static_cast<int>(std::clamp<uint64_t>(value, 1, max_ply - 1));
+    }
+  }
+
+  stop_flag = false;
+  ponder_flag = false;
+  ponder_hit = false;
+  limits.stop = &stop_flag;
+
+  worker = std::thread([this, root = board, limits, infinite, ponder] {
+    Engine::SearchResult result;
+    bool timed = true;
+    if (ponder) {
+      // Search off the clock until the GUI says whether the expected move
+      // was played: on ponderhit search again on the clock, with a warm
+      // hash table; on stop report what pondering found.
+      Engine::SearchLimits pondering;
+      pondering.depth = limits.depth;
+      pondering.stop = &ponder_flag;
+      result = engine.search(root, pondering);
+
+      std::unique_lock lock(mutex);
+      stopped.wait(lock, [this] { return ponder_hit || stop_flag.load(); });
+      timed = !stop_flag;
+    }
+    if (timed) {
+      result = engine.search(root, limits);
+    }
+
+    // An infinite search reports its move only once told to stop.
+    if (infinite) {
+      std::unique_lock lock(mutex);
+      stopped.wait(lock, [this] { return stop_flag.load(); });
+    }
+
+    if (result.move == Move{}) {
+      std::println("bestmove 0000");
+      return;
+    }
+    // The reply we expect, for the GUI to ponder on.
+    std::vector<Move> line = engine.principal_variation(root, result.move, 2);
+    if (line.size() > 1) {
+      std::println("bestmove {} ponder {}", to_string(line[0]), to_string(line[1]));
+    } else {
+      std::println("bestmove {}", to_string(result.move));
+    }
+  });
+}
+
+// setoption name <id> [value <x>]
+void Uci::set_option(std::istringstream &args) {
+  std::string token;
+  std::string name;
+  std::string value;
+  args >> token;
+  while (args >> token && token != "value") {
+    name += name.empty() ? token : " " + token;
+  }
+  std::getline(args >> std::ws, value);
+
+  uint64_t number = 0;
+  if (name == "Hash" || name == "Threads") {
+    if (parse_number(value, number) || number == 0) {
+      std::println("info string invalid value for {}: {}", name, value);
+      return;
+    }
+  }
+
+  if (name == "Hash") {
+    engine.set_hash(number);
+  } else if (name == "Threads") {
+    engine.set_threads(number);
+  } else if (name == "EvalFile") {
+    // A failed load has already said why and leaves the evaluation as is.
+    engine.load_network(value == "<empty>" ? "" : value);
+  } else if (name == "BookFile") {
+    engine.load_book(value == "<empty>" ? "" : value);
+  } else if (name == "Ponder") {
+    // Only tells us the GUI may send go ponder; nothing to set up.
+  } else {
+    std::println("info string unknown option {}", name);
+  }
+}
+
+void Uci::stop_search() {
+  if (!worker.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard lock(mutex);
+    stop_flag = true;
+    ponder_flag = true;
+  }
+  stopped.notify_all();
+  worker.join();
+}
+
+void Uci::ponder_hit_received() {
+  {
+    std::lock_guard lock(mutex);
+    ponder_hit = true;
+    ponder_flag = true;
+  }
+  stopped.notify_all();
+}
+
+void Uci::print_info(const Engine::SearchResult &result) {
+  // UCI scores are from the side to move's point of view.
+  int32_t score = board.turn == Color::White ? result.score : -result.score;
+  std::string score_text;
+  if (std::abs(score) >= mate_threshold) {
+    int moves = (mate_score - std::abs(score) + 1) / 2;
+    score_text = std::format("mate {}", score > 0 ? moves : -moves);
+  } else {
+    score_text = std::format("cp {}", score);
+  }
+
+  std::string pv;
+  for (const Move &move : engine.principal_variation(board, result.move, result.depth)) {
+    pv += " " + to_string(move);
+  }
+
+  uint64_t nps = result.seconds > 0.0 ? static_cast<uint64_t>(result.nodes / result.seconds) : 0;
+  std::println("info depth {} score {} nodes {} nps {} time {} hashfull {} pv{}",
+               result.depth, score_text, result.nodes, nps,
+               static_cast<uint64_t>(result.seconds * 1000),
+               engine.transposition_table().hashfull(), pv);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "board.h"
+#include "engine.h"
+
+// Universal Chess Interface front-end. Commands are read on the calling
+// thread and each `go` runs on a worker thread, so `stop` and `isready`
+// are answered while a search is in progress.
+class Uci {
+public:
+  Uci();
+  ~Uci();
+
+  // Reads commands until `quit` or the end of the input.
+  int run(std::istream &in = std::cin);
+
+private:
+  void position(std::istringstream &args);
+  void go(std::istringstream &args);
+  void set_option(std::istringstream &args);
+
+  // Ends the running search, if any, and waits for its bestmove.
+  void stop_search();
+
+  // The opponent played the expected move: a ponder search goes on under
+  // the clock.
+  void ponder_hit_received();
+
+  void print_info(const Engine::SearchResult &result);
+
+  Engine engine;
+  Board board;
+
+  std::thread worker;
+  std::atomic<bool> stop_flag = false;
+  std::atomic<bool> ponder_flag = false; // ends a ponder search on stop or ponderhit
+  bool ponder_hit = false;               // guarded by mutex
+  std::mutex mutex;
+  std::condition_variable stopped; // wakes an infinite or pondering worker
+};
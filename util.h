@@ -2,15 +2,17 @@
 
 #include <string>
 #include <fstream>
-#include <sstream>
 
 namespace util {
 
+// For single positions and other small files; see MappedFile for corpora.
 inline std::string read_file(const std::string &file_path) {
-  std::stringstream ss;
-  std::ifstream fs(file_path);
-  ss << fs.rdbuf();
-  return ss.str();
+  std::ifstream fs(file_path, std::ios::binary | std::ios::ate);
+  std::streamoff size = fs ? static_cast<std::streamoff>(fs.tellg()) : 0;
+  std::string text(size > 0 ? static_cast<size_t>(size) : 0, '\0');
+  fs.seekg(0);
+  fs.read(text.data(), static_cast<std::streamsize>(text.size()));
+  return text;
 }
 
 template<std::integral T, std::integral R>
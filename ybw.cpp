@@ -0,0 +1,216 @@
+#include "engine.h"
+
+#include <mutex>
+#include <thread>
+
+#include "eval.h"
+#include "threadpool.h"
+
+// Nodes shallower than this are searched serially; sharing them costs more
+// than it saves.
+static constexpr int min_split_depth = 3;
+
+struct Engine::SplitPoint {
+  std::mutex mutex;
+  Board board;
+  int depth = 0;
+  int ply = 0;
+  bool white = true;
+
+  // Guarded by mutex.
+  int32_t alpha = 0;
+  int32_t beta = 0;
+  int32_t best_score = 0;
+  Move best = {};
+
+  std::atomic<int> pending = 0;
+  std::atomic<bool> cutoff = false;
+  SplitPoint *parent = nullptr;
+
+  // A beta cutoff here or at any enclosing split point makes the work
+  // below it useless.
+  bool aborted() const {
+    for (const SplitPoint *sp = this; sp; sp = sp->parent) {
+      if (sp->cutoff.load(std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// Young Brothers Wait: the first move of a node is searched alone to set a
+// bound, then the remaining moves are pushed to the calling thread's deque
+// where idle threads can steal them. The owner helps with queued work until
+// all of its children are done.
+int32_t Engine::ybw(SearchThread &thread, Board &board, int depth, int ply, bool white,
+                    int32_t alpha, int32_t beta, SplitPoint *split) {
+  if (depth < min_split_depth || ply >= max_ply) {
+    return alpha_beta(thread, board, depth, ply, white, alpha, beta);
+  }
+
+  thread.nodes.store(thread.nodes.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  check_limits(thread);
+  if (stop_requested || (split && split->aborted())) {
+    return 0;
+  }
+
+  int32_t alpha_orig = alpha;
+  int32_t beta_orig = beta;
+  uint16_t hash_move = 0;
+
+  TranspositionTable::Entry entry;
+  thread.tt_stats.probes++;
+  if (tt.probe(board.hash, entry)) {
+    thread.tt_stats.hits++;
+    hash_move = entry.move;
+
+    if (entry.depth >= depth) {
+      int32_t score = score_from_tt(entry.score, ply);
+      switch (entry.bound()) {
+      case TranspositionTable::Bound::Exact:
+        return score;
+      case TranspositionTable::Bound::Lower:
+        alpha = std::max(alpha, score);
+        break;
+      case TranspositionTable::Bound::Upper:
+        beta = std::min(beta, score);
+        break;
+      default:
+        break;
+      }
+
+      if (beta <= alpha) {
+        return score;
+      }
+    }
+  }
+
+  MoveList moves;
+  generate_moves(board, moves);
+
+  if (moves.empty()) {
+    if (in_check(board, board.turn)) {
+      return white ? -(mate_score - ply) : mate_score - ply;
+    }
+    return 0;
+  }
+
+  MovePicker picker(board, moves, unpack_move(hash_move),
+                    thread.killers.killers[ply], thread.history);
+
+  // Eldest brother.
+  Move first;
+  picker.next(first);
+
+  Undo undo;
+  do_move(thread, board, first, undo, ply);
+  int32_t best_score = ybw(thread, board, depth - 1, ply + 1, !white, alpha, beta, split);
+  undo_move(board, first, undo);
+  Move best = first;
+
+  if (stop_requested || (split && split->aborted())) {
+    return 0;
+  }
+
+  if (white) {
+    alpha = std::max(alpha, best_score);
+  } else {
+    beta = std::min(beta, best_score);
+  }
+
+  if (beta <= alpha) {
+    if (!MovePicker::is_capture(board, first) && first.promotion == PieceType::None) {
+      thread.killers.update(ply, first);
+      thread.history.update(board.turn, first, depth * depth);
+    }
+  } else if (moves.size() > 1) {
+    // Young brothers.
+    SplitPoint sp;
+    sp.board = board;
+    sp.depth = depth;
+    sp.ply = ply;
+    sp.white = white;
+    sp.alpha = alpha;
+    sp.beta = beta;
+    sp.best_score = best_score;
+    sp.best = best;
+    sp.parent = split;
+    sp.pending = static_cast<int>(moves.size()) - 1;
+
+    Move m;
+    while (picker.next(m)) {
+      pool->push(thread.id, [this, &sp, m](size_t worker) {
+        run_split_task(*search_threads[worker], sp, m);
+      });
+    }
+
+    // Help instead of blocking; whatever runs here may belong to another
+    // split point, which is fine since every task carries its own.
+    while (sp.pending.load(std::memory_order_acquire) > 0) {
+      if (!pool->run_one(thread.id)) {
+        std::this_thread::yield();
+      }
+    }
+
+    best_score = sp.best_score;
+    best = sp.best;
+  }
+
+  if (stop_requested || (split && split->aborted())) {
+    return 0;
+  }
+
+  TranspositionTable::Bound bound = TranspositionTable::Bound::Exact;
+  if (best_score <= alpha_orig) {
+    bound = TranspositionTable::Bound::Upper;
+  } else if (best_score >= beta_orig) {
+    bound = TranspositionTable::Bound::Lower;
+  }
+  tt.store(board.hash, score_to_tt(best_score, ply), pack_move(best), depth, bound);
+  thread.tt_stats.stores++;
+
+  return best_score;
+}
+
+void Engine::run_split_task(SearchThread &thread, SplitPoint &sp, const Move &move) {
+  int32_t alpha, beta;
+  {
+    std::lock_guard lock(sp.mutex);
+    alpha = sp.alpha;
+    beta = sp.beta;
+  }
+
+  if (!stop_requested && !sp.aborted()) {
+    Board board = sp.board;
+    Undo undo;
+    do_move(thread, board, move, undo, sp.ply);
+    int32_t score = ybw(thread, board, sp.depth - 1, sp.ply + 1, !sp.white, alpha, beta, &sp);
+
+    std::lock_guard lock(sp.mutex);
+    if (!stop_requested && !sp.aborted()) {
+      if (sp.white ? score > sp.best_score : score < sp.best_score) {
+        sp.best_score = score;
+        sp.best = move;
+      }
+
+      if (sp.white) {
+        sp.alpha = std::max(sp.alpha, score);
+      } else {
+        sp.beta = std::min(sp.beta, score);
+      }
+
+      // Tell the siblings still running to give up.
+      if (sp.beta <= sp.alpha) {
+        sp.cutoff.store(true, std::memory_order_relaxed);
+        if (!MovePicker::is_capture(sp.board, move) && move.promotion == PieceType::None) {
+          thread.killers.update(sp.ply, move);
+          thread.history.update(sp.board.turn, move, sp.depth * sp.depth);
+        }
+      }
+    }
+  }
+
+  sp.pending.fetch_sub(1, std::memory_order_release);
+}
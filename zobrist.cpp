@@ -0,0 +1,63 @@
+#include "zobrist.h"
+
+#include <bit>
+
+uint64_t Zobrist::castling(const Board& board) {
+    uint64_t hash = 0;
+    if (board.castle_white_kingside) {
+        hash ^= castle(castle_white_kingside);
+    }
+    if (board.castle_white_queenside) {
+        hash ^= castle(castle_white_queenside);
+    }
+    if (board.castle_black_kingside) {
+        hash ^= castle(castle_black_kingside);
+    }
+    if (board.castle_black_queenside) {
+        hash ^= castle(castle_black_queenside);
+    }
+    return hash;
+}
+
+uint64_t Zobrist::compute(const Board& board) {
+    uint64_t hash = 0;
+
+    for (Color color : {Color::White, Color::Black}) {
+        for (int type = static_cast<int>(PieceType::Pawn);
+             type <= static_cast<int>(PieceType::King); type++) {
+            uint64_t bb = board.pieces(color, static_cast<PieceType>(type));
+            while (bb) {
+                uint8_t square = static_cast<uint8_t>(std::countr_zero(bb));
+                hash ^= piece(color, static_cast<PieceType>(type), square);
+                bb &= bb - 1;
+            }
+        }
+    }
+
+    if (board.turn == Color::Black) {
+        hash ^= side();
+    }
+
+    hash ^= castling(board);
+
+    if (board.has_en_passant) {
+        hash ^= en_passant(board.en_passant_file);
+    }
+
+    return hash;
+}
+
+uint64_t Zobrist::compute_pawns(const Board& board) {
+    uint64_t hash = 0;
+
+    for (Color color : {Color::White, Color::Black}) {
+        uint64_t bb = board.pieces(color, PieceType::Pawn);
+        while (bb) {
+            uint8_t square = static_cast<uint8_t>(std::countr_zero(bb));
+            hash ^= piece(color, PieceType::Pawn, square);
+            bb &= bb - 1;
+        }
+    }
+
+    return hash;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "board.h"
+
+// Random keys for hashing a position: one per (color, piece, square), one for
+// black to move, one per castling right and one per en passant file.
+class Zobrist {
+public:
+    static constexpr int castle_white_kingside = 0;
+    static constexpr int castle_white_queenside = 1;
+    static constexpr int castle_black_kingside = 2;
+    static constexpr int castle_black_queenside = 3;
+
+    static uint64_t piece(Color color, PieceType type, uint8_t square) {
+        return keys.pieces[static_cast<int>(color)][static_cast<int>(type)][square];
+    }
+
+    static uint64_t side() { return keys.side; }
+
+    static uint64_t castle(int right) { return keys.castle[right]; }
+
+    static uint64_t en_passant(uint8_t file) { return keys.en_passant[file]; }
+
+    // XOR of the keys for every castling right still held.
+    static uint64_t castling(const Board& board);
+
+    // Full recomputation from scratch; the engine keeps Board::hash up to date
+    // incrementally and only uses this to initialize and to verify.
+    static uint64_t compute(const Board& board);
+
+    // The same over the pawns alone: the XOR of their piece keys.
+    static uint64_t compute_pawns(const Board& board);
+
+private:
+    struct Keys {
+        // Indexed by [Color][PieceType]; the PieceType::None row stays zero.
+        std::array<std::array<std::array<uint64_t, 64>, 7>, 2> pieces = {};
+        uint64_t side = 0;
+        std::array<uint64_t, 4> castle = {};
+        std::array<uint64_t, 8> en_passant = {};
+    };
+
+    static constexpr uint64_t splitmix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    static constexpr Keys generate_keys() {
+        Keys k{};
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+        for (int color = 0; color < 2; color++) {
+            for (int type = static_cast<int>(PieceType::Pawn);
+                 type <= static_cast<int>(PieceType::King); type++) {
+                for (int square = 0; square < 64; square++) {
+                    k.pieces[color][type][square] = splitmix64(state);
+                }
+            }
+        }
+        k.side = splitmix64(state);
+        for (auto& key : k.castle) {
+            key = splitmix64(state);
+        }
+        for (auto& key : k.en_passant) {
+            key = splitmix64(state);
+        }
+        return k;
+    }
+
+    static const Keys keys;
+};
+
+inline constexpr Zobrist::Keys Zobrist::keys = Zobrist::generate_keys();